@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+#
+# Generator of synthetic LLVM 3.4 IR for the scalability benchmarks.
+#
+# The functions are emitted directly in SSA form (as after -mem2reg), with
+# their floating point arguments annotated by llvm.float.range, and can be
+# tuned along the dimensions the analyses are sensitive to: the number of
+# floating point instructions, the nesting depth and trip count of the
+# loops, the fan-in of the phi nodes and the density of the floating point
+# branch conditions (control dependencies).
+#
+
+import argparse
+import random
+import sys
+
+# Exactly representable, so that they can be printed in decimal notation
+CONSTANTS = ['0.5', '0.25', '0.75', '1.5', '2.0', '3.0', '0.125', '1.25']
+OPCODES = ['fadd', 'fsub', 'fmul', 'fmul', 'fdiv']
+
+
+class FunctionBuilder(object):
+
+    def __init__(self, name, opts, rng):
+        self.name = name
+        self.opts = opts
+        self.rng = rng
+        self.lines = []
+        self.counter = 0
+        self.block = None
+
+    def fresh(self, prefix='v'):
+        self.counter += 1
+        return '%s%d' % (prefix, self.counter)
+
+    def start_block(self, label):
+        self.lines.append('%s:' % label)
+        self.block = label
+
+    def emit(self, text):
+        self.lines.append('  ' + text)
+
+    def placeholder(self):
+        self.lines.append(None)
+        return len(self.lines) - 1
+
+    def binop(self, live, slot=None):
+        # Combine a live value with another one or with a constant, and
+        # replace one of the live values with the result
+        if slot is None:
+            slot = self.rng.randrange(len(live))
+        op = self.rng.choice(OPCODES)
+        lhs = live[self.rng.randrange(len(live))]
+        if op == 'fdiv' or self.rng.random() < 0.5:
+            rhs = self.rng.choice(CONSTANTS)
+        else:
+            rhs = live[self.rng.randrange(len(live))]
+        res = '%' + self.fresh()
+        self.emit('%s = %s double %s, %s' % (res, op, lhs, rhs))
+        live[slot] = res
+
+    def straight(self, live):
+        for _ in range(self.opts.segment):
+            self.binop(live)
+
+    def branches(self, live):
+        # Cascade of fcmp/br with phi_fanin single-predecessor arms, each
+        # defining the same live value, merged by a phi with phi_fanin
+        # incoming values
+        slot = self.rng.randrange(len(live))
+        merge = self.fresh('merge')
+        incoming = []
+        for arm in range(self.opts.phi_fanin):
+            if arm < self.opts.phi_fanin - 1:
+                cond = '%' + self.fresh('c')
+                self.emit('%s = fcmp olt double %s, %s' % (cond, live[self.rng.randrange(len(live))],
+                                                          self.rng.choice(CONSTANTS)))
+                taken = self.fresh('arm')
+                other = self.fresh('next')
+                self.emit('br i1 %s, label %%%s, label %%%s' % (cond, taken, other))
+            else:
+                taken = None
+                other = None
+            if taken is not None:
+                self.start_block(taken)
+            values = list(live)
+            for _ in range(max(1, self.opts.segment // self.opts.phi_fanin)):
+                self.binop(values, slot)
+            incoming.append((values[slot], self.block))
+            self.emit('br label %%%s' % merge)
+            if other is not None:
+                self.start_block(other)
+        self.start_block(merge)
+        res = '%' + self.fresh()
+        self.emit('%s = phi double %s' % (res, ', '.join('[ %s, %%%s ]' % inc for inc in incoming)))
+        live[slot] = res
+
+    def segments(self, live, count):
+        for _ in range(count):
+            if self.rng.random() < self.opts.branch_density:
+                self.branches(live)
+            else:
+                self.straight(live)
+
+    def loop(self, live, depth, count):
+        # Canonical loop: preheader, header with the induction variable and
+        # one phi per live value, body, latch and exit
+        preheader = self.fresh('ph')
+        header = self.fresh('loop')
+        latch = self.fresh('latch')
+        exit_block = self.fresh('exit')
+        self.emit('br label %%%s' % preheader)
+        self.start_block(preheader)
+        self.emit('br label %%%s' % header)
+        self.start_block(header)
+        iv = '%' + self.fresh('i')
+        next_iv = '%' + self.fresh('i')
+        self.emit('%s = phi i32 [ 0, %%%s ], [ %s, %%%s ]' % (iv, preheader, next_iv, latch))
+        phis = []
+        for slot in range(len(live)):
+            phi = '%' + self.fresh()
+            phis.append((phi, live[slot], self.placeholder()))
+            live[slot] = phi
+
+        self.nest(live, depth - 1, count)
+
+        self.emit('br label %%%s' % latch)
+        self.start_block(latch)
+        cond = '%' + self.fresh('c')
+        bound = str(self.opts.trip_count) if self.opts.trip_count > 0 else '%n'
+        self.emit('%s = add i32 %s, 1' % (next_iv, iv))
+        self.emit('%s = icmp slt i32 %s, %s' % (cond, next_iv, bound))
+        self.emit('br i1 %s, label %%%s, label %%%s' % (cond, header, exit_block))
+        for slot, (phi, init, line) in enumerate(phis):
+            self.lines[line] = '  %s = phi double [ %s, %%%s ], [ %s, %%%s ]' % (
+                phi, init, preheader, live[slot], latch)
+        self.start_block(exit_block)
+
+    def nest(self, live, depth, count):
+        if depth == 0:
+            self.segments(live, count)
+            return
+        outside = count // (depth + 1)
+        self.segments(live, outside)
+        self.loop(live, depth, count - outside)
+
+    def build(self):
+        opts = self.opts
+        args = ['double %%a%d' % i for i in range(opts.width)]
+        if opts.trip_count <= 0:
+            args.append('i32 %n')
+        self.start_block('entry')
+        for i in range(opts.width):
+            self.emit('call void @llvm.float.range.f64(double %%a%d, double %.17e, double %.17e)'
+                      % (i, -opts.input_range, opts.input_range))
+        live = ['%%a%d' % i for i in range(opts.width)]
+
+        count = max(1, opts.size // opts.segment)
+        self.nest(live, opts.depth, count)
+
+        res = live[0]
+        for val in live[1:]:
+            tmp = '%' + self.fresh()
+            self.emit('%s = fadd double %s, %s' % (tmp, res, val))
+            res = tmp
+        self.emit('ret double %s' % res)
+
+        return ['define double @%s(%s) {' % (self.name, ', '.join(args))] + self.lines + ['}', '']
+
+
+def describe(opts):
+    return ' '.join('%s=%s' % item for item in sorted(vars(opts).items()) if item[0] != 'output')
+
+
+def generate(opts, out):
+    rng = random.Random(opts.seed)
+    out.write('; Generated by gen_ir.py, %s\n\n' % describe(opts))
+    for i in range(opts.functions):
+        builder = FunctionBuilder('f%d' % i, opts, rng)
+        out.write('\n'.join(builder.build()))
+        out.write('\n')
+    out.write('declare void @llvm.float.range.f64(double, double, double)\n')
+
+
+def add_arguments(parser):
+    parser.add_argument('--functions', type=int, default=1,
+                        help='number of functions in the module')
+    parser.add_argument('--size', type=int, default=200,
+                        help='floating point instructions per function (approximately)')
+    parser.add_argument('--depth', type=int, default=1,
+                        help='nesting depth of the loops')
+    parser.add_argument('--trip-count', type=int, default=10,
+                        help='trip count of the loops (0: unknown, bounded by an argument)')
+    parser.add_argument('--phi-fanin', type=int, default=2,
+                        help='incoming values of the phi nodes merging the branches')
+    parser.add_argument('--branch-density', type=float, default=0.2,
+                        help='fraction of the code segments guarded by fcmp branches')
+    parser.add_argument('--width', type=int, default=4,
+                        help='floating point values live at any time (and arguments)')
+    parser.add_argument('--segment', type=int, default=8,
+                        help='instructions per straight-line code segment')
+    parser.add_argument('--input-range', type=float, default=10.0,
+                        help='annotated range of the arguments is [-R, R]')
+    parser.add_argument('--seed', type=int, default=0)
+
+
+def check_arguments(parser, opts):
+    if opts.width < 1 or opts.segment < 1 or opts.phi_fanin < 2 or opts.functions < 1:
+        parser.error('--width, --segment and --functions must be at least 1, --phi-fanin at least 2')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate synthetic IR for the float-range benchmarks.')
+    add_arguments(parser)
+    parser.add_argument('-o', '--output', default='-', help='output file (default: stdout)')
+    opts = parser.parse_args()
+    check_arguments(parser, opts)
+    if opts.output == '-':
+        generate(opts, sys.stdout)
+    else:
+        with open(opts.output, 'w') as out:
+            generate(opts, out)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+#
+# Scalability benchmark of the float-range passes.
+#
+# For each configuration of the IR generator (gen_ir.py), a module is
+# generated and run through opt with the LLVMFloatRange plugin loaded.
+# The wall time of FloatRangeAnalysis, PrecisionAnalysis and Float2Fix is
+# taken from -time-passes, the number of instructions analyzed and of
+# visits of the worklist from -stats (only available in +Asserts builds),
+# and the peak memory from the resource usage of opt.
+#
+# The results are written as JSON; given the results of a previous run
+# with --baseline, the configurations whose time or visits per instruction
+# grew more than --tolerance are reported and the script exits with 1.
+#
+# Please set the LLVM_BUILD environment variable to the directory where you
+# built LLVM (as for tests/commandline.sh), or pass --opt and --plugin.
+#
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_ir
+
+# Pass descriptions, as printed by -time-passes
+PASSES = {
+    'range': 'Floating point range analysis',
+    'precision': 'Precision analysis',
+    'float2fix': 'Float to fixed point conversion',
+}
+
+# Statistics, as printed by -stats (group, description)
+STATS = {
+    ('range', 'instructions'): ('float-range-analysis', 'Number of instructions analyzed by the range analysis'),
+    ('range', 'visits'): ('float-range-analysis', 'Number of instruction visits of the range analysis'),
+    ('precision', 'instructions'): ('precision-analysis', 'Number of instructions analyzed by the precision analysis'),
+    ('precision', 'visits'): ('precision-analysis', 'Number of instruction visits of the precision analysis'),
+    ('float2fix', 'converted'): ('float2fix', 'Number of instructions converted from float to fixed point'),
+}
+
+BASELINE = {'size': 200, 'depth': 1, 'trip_count': 10, 'phi_fanin': 2, 'branch_density': 0.2}
+
+# Each dimension is varied in turn, the others staying at the baseline
+SWEEPS = {
+    'size': [50, 200, 800, 3200],
+    'depth': [0, 1, 2, 3, 4],
+    'trip_count': [0, 10, 100, 1000],
+    'phi_fanin': [2, 4, 8, 16],
+    'branch_density': [0.0, 0.2, 0.5, 0.9],
+}
+
+QUICK_SWEEPS = {
+    'size': [50, 400],
+    'depth': [0, 2],
+    'trip_count': [0, 50],
+    'phi_fanin': [2, 8],
+    'branch_density': [0.0, 0.5],
+}
+
+TIME_LINE = re.compile(r'^\s*((?:[\d.]+ \(\s*[\d.]+%\)\s+)+)(?:\d+\s+)?(.+?)\s*$')
+TIME_VALUE = re.compile(r'([\d.]+) \(\s*[\d.]+%\)')
+STAT_LINE = re.compile(r'^\s*(\d+)\s+(\S+)\s+-\s+(.+?)\s*$')
+
+
+def find_tools(opts):
+    build = os.environ.get('LLVM_BUILD')
+    if opts.opt is None or opts.plugin is None:
+        if build is None:
+            sys.exit('Please set the LLVM_BUILD environment variable, or pass --opt and --plugin')
+    if opts.opt is None:
+        outdir = os.path.join(build, 'Release+Asserts')
+        if os.path.isdir(os.path.join(build, 'Debug+Asserts')):
+            outdir = os.path.join(build, 'Debug+Asserts')
+        opts.opt = os.path.join(outdir, 'bin', 'opt')
+    if opts.plugin is None:
+        outdir = os.path.join(build, 'projects', 'float-range', 'Release+Asserts')
+        if os.path.isdir(os.path.join(build, 'projects', 'float-range', 'Debug+Asserts')):
+            outdir = os.path.join(build, 'projects', 'float-range', 'Debug+Asserts')
+        opts.plugin = os.path.join(outdir, 'lib', 'LLVMFloatRange.so')
+
+
+def run(cmd, stdin):
+    # The peak memory is the one of opt only, as reported by wait4
+    start = time.time()
+    with open(stdin) as infile, open(os.devnull, 'w') as devnull:
+        proc = subprocess.Popen(cmd, stdin=infile, stdout=devnull, stderr=subprocess.PIPE,
+                                universal_newlines=True)
+        stderr = proc.stderr.read()
+        _, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.waitstatus_to_exitcode(status) if hasattr(os, 'waitstatus_to_exitcode') \
+            else (status >> 8)
+    wall = time.time() - start
+    if proc.returncode != 0:
+        sys.stderr.write(stderr)
+        sys.exit('%s failed with exit code %d' % (cmd[0], proc.returncode))
+    return stderr, wall, usage.ru_maxrss
+
+
+def parse_times(stderr):
+    times = {}
+    names = dict((desc, key) for key, desc in PASSES.items())
+    for line in stderr.splitlines():
+        match = TIME_LINE.match(line)
+        if match is None or match.group(2) not in names:
+            continue
+        # The wall time is the last column
+        wall = float(TIME_VALUE.findall(match.group(1))[-1])
+        key = names[match.group(2)]
+        times[key] = times.get(key, 0.0) + wall
+    return times
+
+
+def parse_stats(stderr):
+    stats = {}
+    for line in stderr.splitlines():
+        match = STAT_LINE.match(line)
+        if match is not None:
+            stats[(match.group(2), match.group(3))] = int(match.group(1))
+    return stats
+
+
+def bench(opts, config, workdir):
+    parser = argparse.ArgumentParser()
+    gen_ir.add_arguments(parser)
+    gen_opts = parser.parse_args([])
+    gen_opts.functions = opts.functions
+    gen_opts.seed = opts.seed
+    for key, value in config.items():
+        setattr(gen_opts, key, value)
+
+    ll = os.path.join(workdir, 'bench.ll')
+    with open(ll, 'w') as out:
+        gen_ir.generate(gen_opts, out)
+
+    prologue = [opts.opt, '-load', opts.plugin, '-lcssa']
+    passes = ['-float-range-analysis', '-precision-analysis', '-float2fix']
+    cmd = prologue + passes + ['-time-passes', '-stats'] + opts.opt_flags
+
+    # Peak memory of opt without the analyses, to tell their share
+    _, _, base_rss = run(prologue + ['-S'], ll)
+
+    best = None
+    for _ in range(opts.repeat):
+        stderr, wall, rss = run(cmd, ll)
+        times = parse_times(stderr)
+        total = sum(times.values())
+        if best is None or total < best[0]:
+            best = (total, times, stderr, wall, rss)
+    _, times, stderr, wall, rss = best
+    stats = parse_stats(stderr)
+
+    result = {
+        'config': config,
+        'functions': opts.functions,
+        'wall_seconds': wall,
+        'peak_rss_kb': rss,
+        'baseline_rss_kb': base_rss,
+        'passes': {},
+    }
+    for key in PASSES:
+        entry = {'seconds': times.get(key)}
+        for (pass_key, name), stat in STATS.items():
+            if pass_key == key:
+                entry[name] = stats.get(stat)
+        if entry.get('visits') is not None and entry.get('instructions'):
+            entry['visits_per_instruction'] = float(entry['visits']) / entry['instructions']
+        result['passes'][key] = entry
+    return result
+
+
+def configurations(opts):
+    sweeps = QUICK_SWEEPS if opts.quick else SWEEPS
+    seen = set()
+    configs = []
+    for dimension in sorted(sweeps):
+        if opts.only is not None and dimension not in opts.only:
+            continue
+        for value in sweeps[dimension]:
+            config = dict(BASELINE)
+            config[dimension] = value
+            key = tuple(sorted(config.items()))
+            if key not in seen:
+                seen.add(key)
+                configs.append(config)
+    return configs
+
+
+def compare(results, baseline, tolerance):
+    def index(entries):
+        return dict((tuple(sorted(entry['config'].items())), entry) for entry in entries)
+
+    regressions = []
+    old = index(baseline['results'])
+    for key, entry in index(results['results']).items():
+        if key not in old:
+            continue
+        for name, current in entry['passes'].items():
+            previous = old[key]['passes'].get(name, {})
+            for metric in ['seconds', 'visits_per_instruction']:
+                before = previous.get(metric)
+                after = current.get(metric)
+                if before and after is not None and after > before * (1.0 + tolerance):
+                    regressions.append('%s %s %s: %.6g -> %.6g' % (
+                        dict(key), name, metric, before, after))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark the float-range passes on synthetic IR.')
+    parser.add_argument('--opt', help='opt binary (default: from LLVM_BUILD)')
+    parser.add_argument('--plugin', help='LLVMFloatRange.so (default: from LLVM_BUILD)')
+    parser.add_argument('--functions', type=int, default=4,
+                        help='functions in each generated module')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='runs of each configuration (the fastest one is kept)')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--quick', action='store_true', help='run a reduced set of configurations')
+    parser.add_argument('--only', action='append', choices=sorted(SWEEPS),
+                        help='only vary the given dimension (can be repeated)')
+    parser.add_argument('--opt-flag', dest='opt_flags', action='append', default=[],
+                        help='additional option for opt, e.g. --opt-flag=-analysis-widening')
+    parser.add_argument('-o', '--output', default='-', help='JSON output (default: stdout)')
+    parser.add_argument('--baseline', help='JSON output of a previous run to compare with')
+    parser.add_argument('--tolerance', type=float, default=0.2,
+                        help='relative slowdown reported as a regression')
+    opts = parser.parse_args()
+    find_tools(opts)
+
+    workdir = tempfile.mkdtemp(prefix='float-range-bench-')
+    results = {'opt_flags': opts.opt_flags, 'results': []}
+    try:
+        for config in configurations(opts):
+            sys.stderr.write('%s\n' % ' '.join('%s=%s' % item for item in sorted(config.items())))
+            results['results'].append(bench(opts, config, workdir))
+    finally:
+        for name in os.listdir(workdir):
+            os.remove(os.path.join(workdir, name))
+        os.rmdir(workdir)
+
+    text = json.dumps(results, indent=2, sort_keys=True)
+    if opts.output == '-':
+        print(text)
+    else:
+        with open(opts.output, 'w') as out:
+            out.write(text + '\n')
+
+    if opts.baseline is not None:
+        with open(opts.baseline) as infile:
+            regressions = compare(results, json.load(infile), opts.tolerance)
+        for regression in regressions:
+            sys.stderr.write('regression: %s\n' % regression)
+        if regressions:
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,131 @@
+#ifndef CTO_AFFINE_FORM_H_
+#define CTO_AFFINE_FORM_H_
+
+#include "Range.h"
+
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "llvm/Support/raw_ostream.h"
+
+namespace cto {
+
+// Allocates the noise symbols of the affine forms of an analysis: the
+// symbols below the first fresh one are left to the values of the function
+// (e.g. the number of the value), so that the uses of a value share them.
+class NoiseSymbols {
+public:
+  explicit NoiseSymbols(unsigned first) : next(first) {
+  }
+
+  inline unsigned fresh() {
+    return next++;
+  }
+
+private:
+  unsigned next;
+};
+
+// Affine form x0 + x1 e1 + ... + xn en, where each noise symbol ei ranges in
+// [-1, 1] and is shared by the forms depending on the same quantity: the
+// correlations between the values are kept, so that e.g. x - x is 0 and
+// x * (1 - x) is not wider than the function itself by much. The linear
+// operations are exact; the other ones add a fresh noise symbol for the
+// approximation, taken from the allocator of the operands. At most
+// MaxSymbols symbols are kept: the ones with the smallest coefficients are
+// merged into a fresh one, so that the cost of the operations is bounded.
+class AffineForm {
+  friend std::ostream &operator<<(std::ostream &os, const AffineForm &obj);
+  friend llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const AffineForm &obj);
+
+public:
+  static const unsigned MaxSymbols = 16;
+
+  // Top
+  AffineForm() : kind(Unbounded), center(0.0), symbols(NULL) {
+  }
+
+  AffineForm(double k) : kind(Bounded), center(k), symbols(NULL) {
+  }
+
+  // Form of a range, depending on the given noise symbol only
+  static AffineForm fromRange(const Range &r, unsigned symbol, NoiseSymbols *symbols);
+
+  AffineForm operator+(const AffineForm &rhs) const;
+  AffineForm operator-(const AffineForm &rhs) const;
+  AffineForm operator*(const AffineForm &rhs) const;
+  AffineForm operator/(const AffineForm &rhs) const;
+  // Keeps the terms the forms have in common, and covers the rest with a
+  // fresh symbol
+  AffineForm operator|(const AffineForm &rhs) const;
+  bool operator==(const AffineForm &rhs) const;
+
+  bool operator!=(const AffineForm &rhs) const {
+    return !(*this == rhs);
+  }
+
+  // Range of the values of the form
+  Range getRange() const;
+
+  inline double getCenter() const {
+    return center;
+  }
+
+  // Sum of the absolute values of the coefficients
+  double getRadius() const;
+
+  inline unsigned getNumTerms() const {
+    return terms.size();
+  }
+
+  inline unsigned getSymbol(unsigned idx) const {
+    return terms[idx].first;
+  }
+
+  inline bool isTop() const {
+    return kind == Unbounded;
+  }
+
+  inline bool isBottom() const {
+    return kind == Empty;
+  }
+
+  static AffineForm Bottom() {
+    AffineForm res;
+    res.kind = Empty;
+    return res;
+  }
+
+private:
+  enum Kind {
+    Empty, Bounded, Unbounded
+  };
+  typedef std::pair<unsigned, double> term_t;
+
+  Kind kind;
+  double center;
+  // Sorted by symbol, with no repeated symbols
+  std::vector<term_t> terms;
+  NoiseSymbols *symbols;
+
+  // Top or Bottom, if either operand is (Bottom first)
+  bool getSpecialResult(const AffineForm &rhs, AffineForm &res) const;
+
+  // Linear combination a * this + b * rhs
+  AffineForm combine(double a, const AffineForm &rhs, double b) const;
+
+  // Add a term for a fresh symbol, and merge the smallest terms if there
+  // are too many of them
+  void addNoise(double radius);
+  void condense();
+
+  // Form of 1 / this, if it does not contain zero
+  AffineForm reciprocal() const;
+
+  // The result is unbounded if the form does not denote finite values
+  void normalize();
+};
+
+}
+
+#endif
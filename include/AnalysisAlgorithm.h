@@ -1,48 +1,181 @@
 #ifndef CTO_ANALYSIS_ALGORITHM_H_
 #define CTO_ANALYSIS_ALGORITHM_H_
 
+#include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Analysis/LoopInfo.h"
-#include "llvm/Analysis/ScalarEvolution.h"
-#include "llvm/Support/InstIterator.h"
 
-#include <map>
-#include <queue>
+#include "AnalysisArena.h"
+#include "MemoryObjects.h"
+#include "OptionalValue.h"
+#include "Range.h"
+#include "ResultTable.h"
+#include "TripCounts.h"
+#include "ValueNumbering.h"
+
+#include <string>
+#include <vector>
 
 namespace cto {
 
-template<typename T>
+// Description of the command line options the results of the analyses
+// depend on (used to tell apart the cached results)
+std::string getAnalysisConfiguration();
+
+// Values of the command line options of the analyses
+bool isWideningEnabled();
+unsigned getWideningDelay();
+unsigned getNarrowingSteps();
+
+// Abstract domain the range analysis computes the ranges with
+enum RangeDomain {
+  IntervalDomain,
+  IntervalSetDomain,
+  AffineDomain
+};
+RangeDomain getRangeDomain();
+
+// Math functions the analyses know about, either as intrinsics or as calls
+// to the C library (fma and fmuladd are both FMulAdd)
+enum MathFunction {
+  NotMathFunction,
+  Fabs,
+  Sqrt,
+  FMulAdd,
+  FMin,
+  FMax
+};
+MathFunction getMathFunction(const llvm::CallInst &call);
+
+// Casts to floating point the analyses know about
+bool isCastSupported(const llvm::CastInst &cast);
+
+// Whether val is a floating point constant, scalar or vector: res is then
+// the range of its lanes (the undefined lanes of a vector add nothing)
+bool getConstantRange(const llvm::Value *val, Range &res);
+
+// Instructions moving the lanes of floating point vectors, whose result
+// only holds lanes of their floating point operands
+inline bool isLaneOperation(const llvm::Instruction *inst) {
+  return llvm::isa<llvm::ExtractElementInst>(inst) || llvm::isa<llvm::InsertElementInst>(inst)
+         || llvm::isa<llvm::ShuffleVectorInst>(inst);
+}
+
+// Fixpoint algorithm shared by the analyses. The concrete algorithm is the
+// Derived template parameter, which provides the transfer functions:
+//   T visitFAdd(BinaryOperator &), visitFSub, visitFMul, visitFDiv,
+//   T visitCast(CastInst &), T visitSelect(SelectInst &),
+//   T visitMathCall(CallInst &, MathFunction),
+//   T visitLaneOperation(Instruction &),
+//   T visitLoad(LoadInst &), T visitStore(StoreInst &),
+//   T visitPhi(PHINode &), T getUnboundedResult(),
+//   T widen(const T &previous, const T &current), T narrow(...)
+// and may replace isCallSupported, visitCall, isBatchable and visitBatch.
+// They are dispatched statically, so that they are inlined into the loop.
+// The floating point vectors are analyzed as a whole: the result of a
+// vector is the one of all its lanes, which the arithmetic and the casts
+// compute lane by lane, and the lane operations (insertelement,
+// extractelement and shufflevector) move around.
+// Only the loads and stores of the tracked memory objects are visited: the
+// result of a store is the one of the value it writes, and the loads of an
+// object are visited again whenever one of its stores changes.
+// The definitions of the members are in AnalysisAlgorithmImpl.h.
+template <typename Derived, typename T>
 class AnalysisAlgorithm {
 public:
-  typedef std::map<llvm::Value *, T> result_set_t;
+  typedef ResultTable<T> result_table_t;
 
 protected:
-  result_set_t resultSet;
+  const ValueNumbering &numbering;
+  const MemoryObjects &memory;
+  AnalysisArena &arena;
+  result_table_t &resultSet;
+
+  // Result computed so far for val, or NULL if there is none
+  const T *findResult(const llvm::Value *val) const {
+    unsigned idx = numbering.lookup(val);
+    if (idx == ValueNumbering::NotNumbered || !resultSet.has(idx)) {
+      return NULL;
+    }
+    return &resultSet.get(idx);
+  }
+
+  // Maximum number of times the backedge of the loop is taken, if it is
+  // statically known.
+  OptionalValue<uint64_t> getBackedgeTakenCount(llvm::Loop *loop) const {
+    return tripCounts.getBackedgeTakenCount(loop);
+  }
 
 private:
+  // The pending instructions are kept in a bitvector indexed by their
+  // number, and always dequeued starting from the lowest one: as values are
+  // numbered in reverse post-order, definitions are (backedges aside)
+  // visited before their uses.
   struct Worklist {
   private:
-    std::set<llvm::Instruction *> contained;
-    std::queue<llvm::Instruction *> impl;
+    const ValueNumbering *numbering;
+    llvm::BitVector pending;
+    unsigned numPending;
+    unsigned cursor;
   public:
+    Worklist() : numbering(NULL), numPending(0), cursor(0) {
+    }
+    void initialize(const ValueNumbering &N);
+    void enqueueAll();
+    void enqueueSlice(const llvm::BitVector &slice);
     void enqueue(llvm::Instruction *val);
-    llvm::Instruction *dequeue();
+    unsigned peek() const;
+    unsigned dequeue();
     inline bool isEmpty() const {
-      return impl.empty();
+      return numPending == 0;
+    }
+    inline unsigned size() const {
+      return numPending;
     }
   };
 
-  llvm::LoopInfo &loopInfo;
-  llvm::ScalarEvolution &scev;
+  // Maximum number of instructions visited together
+  static const unsigned MaxBatchSize = 32;
+
+  llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> &loopInfo;
+  const TripCounts &tripCounts;
+  const bool useWidening;
+  const unsigned wideningDelay;
+  const unsigned narrowingSteps;
   Worklist wl;
-  std::map<llvm::Value *, unsigned> counter;
+  // Number of visits of each value
+  unsigned *counter;
+  unsigned numInstructions;
+  unsigned numVisits;
+
+  // Instructions visited together, and their results
+  std::vector<llvm::Instruction *> batch;
+  std::vector<T> batchResults;
 
-  virtual T visitFAdd(llvm::BinaryOperator &B) = 0;
-  virtual T visitFSub(llvm::BinaryOperator &B) = 0;
-  virtual T visitFMul(llvm::BinaryOperator &B) = 0;
-  virtual T visitFDiv(llvm::BinaryOperator &B) = 0;
-  virtual T visitPhi(llvm::PHINode &B) = 0;
-  virtual T getUnboundedResult() = 0;
+  inline Derived &derived() {
+    return *static_cast<Derived *>(this);
+  }
+
+  // The cycles of the loops go through the phi nodes in their headers, or
+  // through the memory: a load in a loop may read a store of the previous
+  // iteration
+  bool isWideningPoint(llvm::Instruction *inst) {
+    if (llvm::isa<llvm::LoadInst>(inst)) {
+      return loopInfo.getLoopFor(inst->getParent()) != NULL;
+    }
+    return llvm::isa<llvm::PHINode>(inst) && loopInfo.isLoopHeader(inst->getParent());
+  }
+
+  void enqueueUsers(llvm::Instruction *inst);
+
+  bool isReady(unsigned idx, llvm::Instruction *inst);
+  void collectBatch();
+  bool iterate(bool narrowing);
+  bool settleStores();
+  void run(const llvm::BitVector *slice);
 
   bool isBinaryOperatorSupported(const llvm::BinaryOperator &bop) const {
     switch (bop.getOpcode()) {
@@ -58,28 +191,78 @@ private:
   }
 
 public:
-  AnalysisAlgorithm(llvm::LoopInfo &loopInfo, llvm::ScalarEvolution &scev) :
-    loopInfo(loopInfo), scev(scev) {
+  // Results are written directly into the table, which must have been
+  // reset to the size of the numbering (known values may be set beforehand).
+  // The algorithm only reads the IR of the function and the structures
+  // passed here, so different functions can be analyzed concurrently; its
+  // bookkeeping is allocated in the arena.
+  AnalysisAlgorithm(llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> &loopInfo,
+                    const TripCounts &tripCounts,
+                    const ValueNumbering &numbering, const MemoryObjects &memory,
+                    AnalysisArena &arena, result_table_t &results) :
+    numbering(numbering), memory(memory), arena(arena), resultSet(results),
+    loopInfo(loopInfo), tripCounts(tripCounts), useWidening(isWideningEnabled()),
+    wideningDelay(getWideningDelay()), narrowingSteps(getNarrowingSteps()),
+    counter(arena.allocate<unsigned>(numbering.size(), 0)),
+    numInstructions(0), numVisits(0) {
   }
 
   bool isSupported(llvm::Instruction *inst) {
     if (llvm::isa<llvm::PHINode>(inst)) {
-      return inst->getOperand(0)->getType()->isFloatingPointTy();
+      return inst->getOperand(0)->getType()->isFPOrFPVectorTy();
     } else if (llvm::isa<llvm::BinaryOperator>(inst)) {
-      return isBinaryOperatorSupported(*llvm::dyn_cast<llvm::BinaryOperator>(inst));
+      return isBinaryOperatorSupported(*llvm::cast<llvm::BinaryOperator>(inst));
+    } else if (llvm::isa<llvm::CastInst>(inst)) {
+      return isCastSupported(*llvm::cast<llvm::CastInst>(inst));
+    } else if (llvm::isa<llvm::SelectInst>(inst) || isLaneOperation(inst)) {
+      return inst->getType()->isFPOrFPVectorTy();
+    } else if (llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(inst)) {
+      return getMathFunction(*call) != NotMathFunction || derived().isCallSupported(*call);
+    } else if (llvm::isa<llvm::LoadInst>(inst) || llvm::isa<llvm::StoreInst>(inst)) {
+      return memory.lookup(inst) != MemoryObjects::NotTracked;
     }
     return false;
   }
 
+  // Defaults of the optional parts of the Derived algorithm
+
+  // Calls (other than to the math functions) are only visited by the
+  // analyses that know about the callee
+  bool isCallSupported(llvm::CallInst &call) {
+    return false;
+  }
+  T visitCall(llvm::CallInst &call) {
+    return derived().getUnboundedResult();
+  }
+
+  // Instructions that can be evaluated together by visitBatch: the
+  // consecutive pending ones not using each other are visited at once
+  // (none by default).
+  bool isBatchable(llvm::Instruction *inst) {
+    return false;
+  }
+  void visitBatch(const std::vector<llvm::Instruction *> &insts, std::vector<T> &results);
+
   T visit(llvm::Instruction *inst);
 
-  void analyze(const llvm::inst_iterator &begin, const llvm::inst_iterator &end);
+  void analyze(llvm::Function &F);
 
-  inline result_set_t getResult() {
+  // Recompute only the values in the slice, which must be closed under the
+  // users and whose results must have been cleared: the results of the
+  // other values are taken as final.
+  void analyze(llvm::Function &F, const llvm::BitVector &slice);
+
+  inline const result_table_t &getResult() const {
     return resultSet;
   }
 
-  virtual ~AnalysisAlgorithm() {
+  // Number of instructions (re)analyzed and of transfer functions
+  // evaluated so far, for the statistics
+  inline unsigned getNumInstructions() const {
+    return numInstructions;
+  }
+  inline unsigned getNumVisits() const {
+    return numVisits;
   }
 };
 
@@ -0,0 +1,363 @@
+#ifndef CTO_ANALYSIS_ALGORITHM_IMPL_H_
+#define CTO_ANALYSIS_ALGORITHM_IMPL_H_
+
+// Definitions of the members of AnalysisAlgorithm, to be included by the
+// files defining the concrete algorithms (which are instantiated there).
+
+#include "AnalysisAlgorithm.h"
+
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+namespace cto {
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::Worklist::initialize(const ValueNumbering &N) {
+  numbering = &N;
+  pending.clear();
+  pending.resize(N.size());
+  numPending = 0;
+  cursor = 0;
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::Worklist::enqueueAll() {
+  // Arguments are numbered first, and never visited
+  unsigned first = numbering->getNumArguments();
+  pending.set(first, numbering->size());
+  numPending = numbering->size() - first;
+  cursor = first;
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::Worklist::enqueueSlice(const llvm::BitVector &slice) {
+  unsigned first = numbering->getNumArguments();
+  for (int idx = slice.find_first(); idx >= 0; idx = slice.find_next(idx)) {
+    if (static_cast<unsigned>(idx) >= first && !pending.test(idx)) {
+      pending.set(idx);
+      ++numPending;
+    }
+  }
+  cursor = first;
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::Worklist::enqueue(llvm::Instruction *val) {
+  unsigned idx = numbering->lookup(val);
+  assert(idx != ValueNumbering::NotNumbered && "enqueueing an instruction not numbered");
+  // Do not add elements to the Worklist multiple times
+  if (pending.test(idx)) {
+    return;
+  }
+  pending.set(idx);
+  ++numPending;
+  if (idx < cursor) {
+    cursor = idx;
+  }
+}
+
+template <typename Derived, typename T>
+unsigned AnalysisAlgorithm<Derived, T>::Worklist::peek() const {
+  assert(!isEmpty() && "peek called on an empty worklist");
+  int idx = cursor == 0 ? pending.find_first() : pending.find_next(cursor - 1);
+  assert(idx >= 0 && "pending counter out of sync with the bitvector");
+  return idx;
+}
+
+template <typename Derived, typename T>
+unsigned AnalysisAlgorithm<Derived, T>::Worklist::dequeue() {
+  assert(!isEmpty() && "dequeue called on an empty worklist");
+  // No pending instruction has a number lower than the cursor
+  int idx = cursor == 0 ? pending.find_first() : pending.find_next(cursor - 1);
+  assert(idx >= 0 && "pending counter out of sync with the bitvector");
+  pending.reset(idx);
+  --numPending;
+  cursor = idx + 1;
+  return idx;
+}
+
+template <typename Derived, typename T>
+T AnalysisAlgorithm<Derived, T>::visit(llvm::Instruction *inst) {
+  if (llvm::isa<llvm::BinaryOperator>(inst)) {
+    llvm::BinaryOperator *bop = llvm::cast<llvm::BinaryOperator>(inst);
+    llvm::BinaryOperator::BinaryOps opcode = bop->getOpcode();
+    switch (opcode) {
+    case llvm::BinaryOperator::FAdd:
+      return derived().visitFAdd(*bop);
+      break;
+    case llvm::BinaryOperator::FSub:
+      return derived().visitFSub(*bop);
+      break;
+    case llvm::BinaryOperator::FMul:
+      return derived().visitFMul(*bop);
+      break;
+    case llvm::BinaryOperator::FDiv:
+      return derived().visitFDiv(*bop);
+      break;
+    default:
+      break;
+    }
+  } else if (llvm::isa<llvm::PHINode>(inst)) {
+    llvm::PHINode *phi = llvm::cast<llvm::PHINode>(inst);
+    return derived().visitPhi(*phi);
+  } else if (llvm::isa<llvm::CastInst>(inst)) {
+    return derived().visitCast(*llvm::cast<llvm::CastInst>(inst));
+  } else if (llvm::isa<llvm::SelectInst>(inst)) {
+    return derived().visitSelect(*llvm::cast<llvm::SelectInst>(inst));
+  } else if (isLaneOperation(inst)) {
+    return derived().visitLaneOperation(*inst);
+  } else if (llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(inst)) {
+    MathFunction fn = getMathFunction(*call);
+    if (fn != NotMathFunction) {
+      return derived().visitMathCall(*call, fn);
+    }
+    return derived().visitCall(*call);
+  } else if (llvm::isa<llvm::LoadInst>(inst)) {
+    return derived().visitLoad(*llvm::cast<llvm::LoadInst>(inst));
+  } else if (llvm::isa<llvm::StoreInst>(inst)) {
+    return derived().visitStore(*llvm::cast<llvm::StoreInst>(inst));
+  }
+  llvm::report_fatal_error("Attempting to visit an unsupported instruction");
+  return derived().getUnboundedResult();
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::analyze(llvm::Function &F) {
+  run(NULL);
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::analyze(llvm::Function &F, const llvm::BitVector &slice) {
+  run(&slice);
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::run(const llvm::BitVector *slice) {
+  assert(numbering.size() == resultSet.size() && "result table not initialized");
+  wl.initialize(numbering);
+  if (slice != NULL) {
+    wl.enqueueSlice(*slice);
+  } else {
+    wl.enqueueAll();
+  }
+  numInstructions += wl.size();
+  iterate(false);
+  if (settleStores()) {
+    iterate(false);
+  }
+
+  if (!useWidening) {
+    return;
+  }
+
+  // Descending iterations: starting from the post-fixpoint reached with
+  // widening, recompute every value to recover the precision lost by jumping
+  // to the thresholds. Each step is a single sweep in reverse post-order.
+  for (unsigned step = 0; step < narrowingSteps; ++step) {
+    if (slice != NULL) {
+      wl.enqueueSlice(*slice);
+    } else {
+      wl.enqueueAll();
+    }
+    if (!iterate(true)) {
+      break;
+    }
+  }
+}
+
+template <typename Derived, typename T>
+bool AnalysisAlgorithm<Derived, T>::isReady(unsigned idx, llvm::Instruction *cur) {
+  // Ensure that the instruction is supported
+  if (!isSupported(cur)) {
+    return false;
+  }
+
+  // If we are in a loop, ensure we process each instruction at most the
+  // tripcount (the body is executed once more than the backedge is taken),
+  // if it is statically known, or the maximum number of iterations
+  // Note that this might produce incorrect results for complex structures
+  // even though the tripcount is known!
+  // With widening, loops are instead analyzed until a fixpoint is reached.
+  llvm::Loop *loop = loopInfo.getLoopFor(cur->getParent());
+  if (loop != NULL && !useWidening) {
+    OptionalValue<uint64_t> tripCount = getBackedgeTakenCount(loop);
+    if (tripCount.isValid()) {
+      if (counter[idx] > tripCount.get()) {
+        return false;
+      }
+    } else {
+      // Loops with unknown tripcount are not supported.
+      // Default to unbounded value.
+      // Don't check if the insertion succeeded, we are guaranteed
+      // that this is the first time we've seen this Value*.
+      resultSet.set(idx, derived().getUnboundedResult());
+      if (llvm::isa<llvm::StoreInst>(cur)) {
+        enqueueUsers(cur);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Derived, typename T>
+bool AnalysisAlgorithm<Derived, T>::settleStores() {
+  // The loads only join the stores already visited: a store still without a
+  // result once the worklist is empty was never reached by the visit, and is
+  // taken as unbounded. Its loads are visited again, along with the loops
+  // whose iterations were exhausted.
+  bool unsettled = false;
+  for (unsigned obj = 0; obj < memory.size(); ++obj) {
+    const MemoryObjects::Object &object = memory.getObject(obj);
+    bool found = false;
+    for (std::vector<llvm::StoreInst *>::const_iterator it = object.Stores.begin(),
+         end = object.Stores.end(); it != end; ++it) {
+      unsigned idx = numbering.lookup(*it);
+      if (idx != ValueNumbering::NotNumbered && !resultSet.has(idx)) {
+        resultSet.set(idx, derived().getUnboundedResult());
+        found = true;
+      }
+    }
+    if (found) {
+      for (std::vector<llvm::LoadInst *>::const_iterator it = object.Loads.begin(),
+           end = object.Loads.end(); it != end; ++it) {
+        if (numbering.lookup(*it) != ValueNumbering::NotNumbered) {
+          wl.enqueue(*it);
+        }
+      }
+      unsettled = true;
+    }
+  }
+  if (unsettled) {
+    std::fill(counter, counter + numbering.size(), 0);
+  }
+  return unsettled;
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::collectBatch() {
+  // Extend the batch with the next pending instructions in reverse
+  // post-order, as long as they do not use the ones already in it
+  while (batch.size() < MaxBatchSize && !wl.isEmpty()) {
+    unsigned idx = wl.peek();
+    llvm::Instruction *next = llvm::cast<llvm::Instruction>(numbering.getValue(idx));
+    if (!isSupported(next) || !derived().isBatchable(next)) {
+      return;
+    }
+    for (llvm::User::op_iterator ops = next->op_begin(), opend = next->op_end();
+         ops != opend; ++ops) {
+      if (std::find(batch.begin(), batch.end(), ops->get()) != batch.end()) {
+        return;
+      }
+    }
+    wl.dequeue();
+    if (isReady(idx, next)) {
+      batch.push_back(next);
+    }
+  }
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::visitBatch(const std::vector<llvm::Instruction *> &insts,
+                                               std::vector<T> &results) {
+  for (std::vector<llvm::Instruction *>::const_iterator it = insts.begin(), end = insts.end();
+       it != end; ++it) {
+    results.push_back(visit(*it));
+  }
+}
+
+template <typename Derived, typename T>
+bool AnalysisAlgorithm<Derived, T>::iterate(bool narrowing) {
+  bool changed = false;
+
+  while (!wl.isEmpty()) {
+    unsigned first = wl.dequeue();
+    llvm::Instruction *firstInst = llvm::cast<llvm::Instruction>(numbering.getValue(first));
+    if (!isReady(first, firstInst)) {
+      continue;
+    }
+
+    batch.clear();
+    batchResults.clear();
+    batch.push_back(firstInst);
+    if (derived().isBatchable(firstInst)) {
+      collectBatch();
+    }
+
+#ifdef TRACE_VISITING
+    for (unsigned i = 0; i < batch.size(); ++i) {
+      llvm::errs() << "Visiting ";
+      batch[i]->print(llvm::errs());
+      llvm::errs() << "\n";
+    }
+#endif
+
+    if (batch.size() == 1) {
+      batchResults.push_back(visit(firstInst));
+    } else {
+      derived().visitBatch(batch, batchResults);
+    }
+    numVisits += batch.size();
+
+    for (unsigned i = 0; i < batch.size(); ++i) {
+      llvm::Instruction *cur = batch[i];
+      unsigned idx = numbering.lookup(cur);
+      T result = batchResults[i];
+
+      bool firstVisit = !resultSet.has(idx);
+      counter[idx]++;
+
+      if (!firstVisit && isWideningPoint(cur)) {
+        if (narrowing) {
+          result = derived().narrow(resultSet.get(idx), result);
+        } else if (useWidening && counter[idx] > wideningDelay) {
+          result = derived().widen(resultSet.get(idx), result);
+        }
+      }
+
+      if (firstVisit || resultSet.get(idx) != result) {
+        resultSet.set(idx, result);
+      } else {
+        // Nothing changed, so there is no need to visit the users again
+        continue;
+      }
+      changed = true;
+
+      // Narrowing sweeps already visit every instruction in order
+      if (narrowing) {
+        continue;
+      }
+
+      enqueueUsers(cur);
+    }
+  }
+
+  return changed;
+}
+
+template <typename Derived, typename T>
+void AnalysisAlgorithm<Derived, T>::enqueueUsers(llvm::Instruction *inst) {
+  if (llvm::isa<llvm::StoreInst>(inst)) {
+    // The loads of the object read the value stored
+    const MemoryObjects::Object &object = memory.getObject(memory.lookup(inst));
+    for (std::vector<llvm::LoadInst *>::const_iterator it = object.Loads.begin(),
+         end = object.Loads.end(); it != end; ++it) {
+      wl.enqueue(*it);
+    }
+    return;
+  }
+  for (llvm::Value::use_iterator u = inst->use_begin(), e = inst->use_end();
+       u != e; ++u) {
+    if (llvm::isa<llvm::Instruction>(*u)) {
+      wl.enqueue(llvm::dyn_cast<llvm::Instruction>(*u));
+    } else {
+      llvm::report_fatal_error("Found uses that are not instructions. This is unsupported.");
+    }
+  }
+}
+
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CTO_ANALYSIS_ARENA_H_
+#define CTO_ANALYSIS_ARENA_H_
+
+#include "llvm/Support/Allocator.h"
+
+#include <algorithm>
+
+namespace cto {
+
+// Scratch memory of the analysis of a function: the bookkeeping of the
+// algorithms (visit counters, flags, branch constraints) is bump-allocated
+// here and released at once when the next function is analyzed. The passes
+// keep an arena across their runs, so that the allocator keeps its memory
+// instead of building and freeing containers for each function. Only
+// trivially destructible objects are allocated, as they are never
+// destroyed. An arena must not be shared by concurrent analyses, nor by
+// nested ones (e.g. the analyses of the callees run by the
+// interprocedural analysis while analyzing the caller).
+class AnalysisArena {
+public:
+  // Array of n objects, all equal to init
+  template <typename T>
+  T *allocate(unsigned n, const T &init) {
+    T *res = allocator.Allocate<T>(n);
+    std::fill(res, res + n, init);
+    return res;
+  }
+
+  // Release everything allocated so far: the first slab is kept
+  void reset() {
+    allocator.Reset();
+  }
+
+private:
+  llvm::BumpPtrAllocator allocator;
+};
+
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef CTO_FIXED_POINT_FORMAT_H_
+#define CTO_FIXED_POINT_FORMAT_H_
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Value.h"
+#include "llvm/Analysis/LoopInfo.h"
+
+#include "FloatRangeAnalysis.h"
+#include "OptionalValue.h"
+#include "Range.h"
+
+#include <string>
+
+#define WORD_LENGTH 64
+
+namespace cto {
+
+// Whether the values may be stored in integers narrower than the word
+// (-fixed-point-narrowing)
+bool isNarrowingEnabled();
+
+// Fractional bits requested for the converted values (-precision-bitwidth)
+unsigned getRequestedPrecision();
+
+// Description of the command line options the formats depend on (used to
+// tell apart the cached errors)
+std::string getFormatConfiguration();
+
+// Narrowest of the integer types of 8, 16, 32, 64 and 128 bits holding the
+// given number of bits. Only the intermediate products and dividends may
+// need the double word.
+unsigned getContainingWidth(int bits);
+
+// Bits taken by the integer part of the values in the range, in two's
+// complement (0 if the range is empty, invalid if it is unbounded)
+OptionalValue<uint64_t> getIntegerBits(const Range &r);
+
+// Width of the integer a value whose integer part takes the given bits is
+// stored in: the word, or with narrowing the narrowest integer keeping the
+// requested fractional bits (plus a few guard bits, as the errors of the
+// operations add up)
+unsigned getStorageWidth(OptionalValue<uint64_t> integerBits);
+
+// Fractional bits of the fixed point format of a value whose integer part
+// takes the given bits. In a word, all the bits left by the integer part
+// but one, so that the sum of two values of any format fits in the word
+// once aligned; in a narrower integer, all of them (the operations are
+// computed in an integer wide enough for their operands and result).
+int getFractionalBits(OptionalValue<uint64_t> integerBits);
+
+// Largest error of moving a fixed point value from a format (its number of
+// fractional bits) to another: a right shift drops the bits below the new
+// format, a left shift is exact
+double getAlignmentError(int from, int to);
+
+// The operations between values of different formats, as float2fix lowers
+// them and the precision analysis bounds their errors.
+
+// Operands of sums, subtractions and comparisons are aligned to the
+// format of the one with the widest range
+inline int getCommonFormat(int f1, int f2) {
+  return f1 < f2 ? f1 : f2;
+}
+
+// Product of values with f1 and f2 fractional bits, whose integer part takes
+// integerBits: it has f1 + f2 fractional bits, and where it does not fit in
+// the word it is computed in a double word, whose high part is then kept.
+// Only if it would not fit there either, the operands are shifted right by
+// Shift1 and Shift2 first, starting from the one with more fractional bits.
+struct ProductLowering {
+  int Shift1;
+  int Shift2;
+  int Fraction;
+
+  ProductLowering(int f1, int f2, OptionalValue<uint64_t> integerBits);
+};
+
+// Quotient of values with f1 and f2 fractional bits: the dividend is
+// shifted left by Shift (right if negative) so that the quotient gets the
+// fractional bits of the result, as far as the dividend, whose integer part
+// takes dividendBits, still fits in a double word. The quotient has
+// Fraction fractional bits, no more than the result.
+struct QuotientLowering {
+  int Shift;
+  int Fraction;
+
+  QuotientLowering(int f1, int f2, int result, OptionalValue<uint64_t> dividendBits);
+};
+
+// Quotient by a constant, or by a value defined out of the loops around the
+// division, whose range does not hold zero: instead of a division, it is the
+// product of the dividend by the reciprocal of the divisor, lowered as any
+// other product. The reciprocal is computed once, folded for the constants,
+// or otherwise divided at the end of Preheader, the one of the outermost of
+// those loops; its integer part takes IntegerBits, and it is truncated to
+// Fraction fractional bits.
+struct ReciprocalLowering {
+  llvm::BasicBlock *Preheader;
+  OptionalValue<uint64_t> IntegerBits;
+  int Fraction;
+
+  ReciprocalLowering() :
+    Preheader(NULL), IntegerBits(OptionalValue<uint64_t>::invalid()), Fraction(0) {
+  }
+};
+
+// Fixed point formats of the values of a function, each chosen from its own
+// range, and the widths of the integers holding them. The elements of a
+// memory object share the format of the widest of its loads and stores, in
+// an integer holding all of them.
+class FixedPointFormats {
+public:
+  explicit FixedPointFormats(const FunctionRanges &ranges) :
+    ranges(ranges), uniform(false), uniformFraction(0) {
+  }
+
+  // Use the same format for every value (for debugging the conversion)
+  void setUniform(int fraction) {
+    uniform = true;
+    uniformFraction = fraction;
+  }
+
+  OptionalValue<uint64_t> getIntegerBits(const llvm::Value *val) const {
+    return cto::getIntegerBits(ranges.getRange(val));
+  }
+
+  int getFormat(const llvm::Value *val) const {
+    return uniform ? uniformFraction : getFractionalBits(getIntegerBits(val));
+  }
+
+  unsigned getWidth(const llvm::Value *val) const {
+    return uniform ? WORD_LENGTH : getStorageWidth(getIntegerBits(val));
+  }
+
+  // The product of fmuladd is not a value of its own, but gets a format the
+  // same way
+  OptionalValue<uint64_t> getProductBits(const llvm::Value *val1,
+                                         const llvm::Value *val2) const {
+    return cto::getIntegerBits(ranges.getRange(val1) * ranges.getRange(val2));
+  }
+
+  int getProductFormat(const llvm::Value *val1, const llvm::Value *val2) const {
+    return uniform ? uniformFraction : getFractionalBits(getProductBits(val1, val2));
+  }
+
+  unsigned getProductWidth(const llvm::Value *val1, const llvm::Value *val2) const {
+    return uniform ? WORD_LENGTH : getStorageWidth(getProductBits(val1, val2));
+  }
+
+  // Whether the division is lowered with the reciprocal of its divisor, and
+  // how (a division out of the loops is only worth it for a constant)
+  bool getReciprocalLowering(const llvm::BinaryOperator &div,
+                             const llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> &LI,
+                             ReciprocalLowering &res) const;
+
+  int getObjectFormat(unsigned object) const;
+  unsigned getObjectWidth(unsigned object) const;
+
+  // Format and width of the elements of the object accessed by a load or a
+  // store
+  int getAccessFormat(const llvm::Instruction *access) const {
+    return getObjectFormat(ranges.Memory.lookup(access));
+  }
+  unsigned getAccessWidth(const llvm::Instruction *access) const {
+    return getObjectWidth(ranges.Memory.lookup(access));
+  }
+
+private:
+  const FunctionRanges &ranges;
+  bool uniform;
+  int uniformFraction;
+};
+
+}
+
+#endif
@@ -4,27 +4,119 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
 
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/Dominators.h"
+#include "llvm/ADT/BitVector.h"
 
+#include "AnalysisAlgorithm.h"
+#include "AnalysisArena.h"
+#include "MemoryObjects.h"
 #include "Range.h"
 #include "OptionalValue.h"
+#include "ResultTable.h"
+#include "TripCounts.h"
+#include "ValueNumbering.h"
 
+#include <algorithm>
 #include <map>
+#include <vector>
 
 namespace cto {
 
-typedef std::map<const llvm::Value *, cto::Range> range_store_t;
+typedef ResultTable<cto::Range> range_store_t;
+
+// Ranges computed for a single function, indexed by the numbering of its
+// values.
+struct FunctionRanges {
+  ValueNumbering Numbering;
+  range_store_t Store;
+  OptionalValue<uint64_t> MinimumBits;
+
+  // Memory whose loads and stores are analyzed
+  MemoryObjects Memory;
+
+  // Numbers of the floating point values and of the instructions using
+  // them, in increasing order: the only values the passes need to look at
+  std::vector<unsigned> FPSlice;
+
+  // What the results depend on (the annotated ranges, and the opcode and
+  // operands of each value), to find the values changed since the analysis.
+  // The signatures do not depend on the addresses of the IR objects, and
+  // the values are matched by their number: a value allocated where a
+  // deleted one was is not mistaken for it.
+  std::map<const llvm::Value *, cto::Range> KnownRanges;
+  std::vector<uint64_t> Signatures;
+
+  // Values whose range was computed by the last (re)analysis, and whether
+  // the numbering changed with it; Generation counts the (re)analyses
+  llvm::BitVector Updated;
+  bool Renumbered;
+  unsigned Generation;
+
+  // Key of the results in the persistent cache (0 if not cached), and of
+  // the cached results of the previous version they were updated from
+  uint64_t CacheKey;
+  uint64_t PreviousKey;
+
+  FunctionRanges() : MinimumBits(OptionalValue<uint64_t>::invalid()),
+    Renumbered(true), Generation(0), CacheKey(0), PreviousKey(0) {
+  }
+
+  cto::Range getRangeAt(unsigned idx) const {
+    return Store.has(idx) ? Store.get(idx) : Range::Top;
+  }
+
+  cto::Range getRange(const llvm::Value *val) const {
+    Range r;
+    if (getConstantRange(val, r)) {
+      return r;
+    }
+    return getRangeAt(Numbering.lookup(val));
+  }
+
+  void swap(FunctionRanges &other) {
+    Numbering.swap(other.Numbering);
+    Store.swap(other.Store);
+    std::swap(MinimumBits, other.MinimumBits);
+    Memory.swap(other.Memory);
+    FPSlice.swap(other.FPSlice);
+    KnownRanges.swap(other.KnownRanges);
+    Signatures.swap(other.Signatures);
+    Updated.swap(other.Updated);
+    std::swap(Renumbered, other.Renumbered);
+    std::swap(Generation, other.Generation);
+    std::swap(CacheKey, other.CacheKey);
+    std::swap(PreviousKey, other.PreviousKey);
+  }
+};
+
+// Computes the range of the value returned by a call, given the ranges of
+// its arguments (Top for the ones that are not floating point)
+class CallRangeOracle {
+public:
+  virtual ~CallRangeOracle() {
+  }
+  virtual bool handlesCall(const llvm::CallInst &call) = 0;
+  virtual cto::Range getReturnRange(llvm::CallInst &call,
+                                    const std::vector<cto::Range> &args) = 0;
+};
+
+typedef std::map<const llvm::Value *, cto::Range> input_ranges_t;
 
 struct FloatRangeAnalysis : public llvm::FunctionPass {
   static char ID;
 
-  FloatRangeAnalysis() : llvm::FunctionPass(ID) {
+  FloatRangeAnalysis() : llvm::FunctionPass(ID), Ranges(NULL) {
   }
   virtual bool runOnFunction(llvm::Function &F);
 
+  // The results kept across the runs are dropped when the pass manager
+  // invalidates the analysis, as the functions may then be deleted
+  virtual void releaseMemory();
+
   virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const {
     AU.addRequired<llvm::ScalarEvolution>();
     AU.addRequired<llvm::LoopInfo>();
@@ -33,26 +125,67 @@ struct FloatRangeAnalysis : public llvm::FunctionPass {
   }
   void printAll(const llvm::Function &F) const;
 
-  cto::Range getRange(const llvm::Value *val) {
-    if (const llvm::ConstantFP *CFP = llvm::dyn_cast<const llvm::ConstantFP>(val)) {
-      return Range(CFP->getValueAPF().convertToDouble());
-    } else {
-      std::map<const llvm::Value *, Range>::iterator found = Store.find(val);
-      if (found != Store.end()) {
-        return found->second;
-      }
-    }
-    return Range::Top;
+  // Analyze F outside of the pass manager. Only F and the structures passed
+  // here are accessed, so different functions can be analyzed concurrently.
+  // The input ranges (of arguments and call results, computed from the rest
+  // of the module) refine the annotated ones; the calls handled by the
+  // oracle are analyzed as the other instructions. The bookkeeping of the
+  // algorithms is allocated in the arena, which is reset first (a local one
+  // is used if none is given).
+  static void computeRanges(llvm::Function &F,
+                            llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> &LI,
+                            llvm::DominatorTreeBase<llvm::BasicBlock> &DT,
+                            const TripCounts &TC,
+                            FunctionRanges &result,
+                            const input_ranges_t *inputRanges = NULL,
+                            CallRangeOracle *oracle = NULL,
+                            AnalysisArena *arena = NULL);
+
+  // Update the results of a previous analysis of F after the IR or the
+  // annotations changed: only the forward slice of the changed values
+  // (their transitive users, and the values constrained by a comparison
+  // with them) is recomputed.
+  static void updateRanges(llvm::Function &F,
+                           llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> &LI,
+                           llvm::DominatorTreeBase<llvm::BasicBlock> &DT,
+                           const TripCounts &TC,
+                           FunctionRanges &result,
+                           const input_ranges_t *inputRanges = NULL,
+                           AnalysisArena *arena = NULL);
+
+  // The results refer to the last function analyzed, and are indexed by
+  // the numbering of its values.
+  const FunctionRanges &getRanges() const {
+    return *Ranges;
+  }
+
+  const ValueNumbering &getNumbering() const {
+    return Ranges->Numbering;
+  }
+
+  const std::vector<unsigned> &getFPSlice() const {
+    return Ranges->FPSlice;
+  }
+
+  cto::Range getRangeAt(unsigned idx) const {
+    return Ranges->getRangeAt(idx);
+  }
+
+  cto::Range getRange(const llvm::Value *val) const {
+    return Ranges->getRange(val);
   }
 
   OptionalValue<uint64_t> getMinimumIntegerBitWidth(const llvm::Function &F) const;
 
 private:
-  range_store_t Store;
+  // The results of each function are kept, so that running the analysis
+  // again on it only updates what changed
+  std::map<const llvm::Function *, FunctionRanges> Results;
+  FunctionRanges *Ranges;
+  // Scratch memory of the analyses, reused by all the functions
+  AnalysisArena Arena;
   std::map<const llvm::Function *, OptionalValue<uint64_t> > minimumBits;
   bool propagate(llvm::Instruction *II);
-  OptionalValue<uint64_t> computeMinimumBits(const llvm::Function &F);
-  OptionalValue<uint64_t> computeBitsForValue(const llvm::Value &I);
 };
 
 }
@@ -0,0 +1,46 @@
+#ifndef CTO_INTERPROCEDURAL_RANGE_ANALYSIS_H_
+#define CTO_INTERPROCEDURAL_RANGE_ANALYSIS_H_
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+
+#include "FloatRangeAnalysis.h"
+#include "Range.h"
+
+namespace cto {
+
+// Propagates the ranges across the calls of the module: the ranges of the
+// arguments from the call sites to the callees, and the ranges of the
+// returned values back to the callers. Each function is analyzed once for
+// each distinct combination of argument ranges it is called with, and the
+// resulting summaries are cached.
+// FloatRangeAnalysis then uses the ranges of the arguments of the internal
+// functions (joined over all the call sites) and of the values returned by
+// the calls (joined over all the contexts of the caller) as known ranges.
+struct InterproceduralRangeAnalysis : public llvm::ModulePass {
+  static char ID;
+
+  InterproceduralRangeAnalysis() : llvm::ModulePass(ID) {
+  }
+
+  virtual bool runOnModule(llvm::Module &M);
+
+  virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const {
+    AU.addRequired<llvm::LoopInfo>();
+    AU.addRequired<llvm::ScalarEvolution>();
+    AU.setPreservesAll();
+  }
+
+  const input_ranges_t &getInputRanges() const {
+    return inputRanges;
+  }
+
+private:
+  input_ranges_t inputRanges;
+};
+
+}
+
+#endif
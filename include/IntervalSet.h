@@ -0,0 +1,86 @@
+#ifndef CTO_INTERVAL_SET_H_
+#define CTO_INTERVAL_SET_H_
+
+#include "Range.h"
+
+#include <ostream>
+#include <vector>
+#include "llvm/Support/raw_ostream.h"
+
+namespace cto {
+
+// Union of at most MaxIntervals disjoint ranges, sorted by their bounds.
+// The operators apply the ones of Range to each pair of intervals: e.g. the
+// union of [-5, -4] and [4, 5] stays split, and so does its reciprocal,
+// while the Range would be [-5, 5] and its reciprocal Top. When an operation
+// gives more intervals than that, the closest ones are merged.
+class IntervalSet {
+  friend std::ostream &operator<<(std::ostream &os, const IntervalSet &obj);
+  friend llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const IntervalSet &obj);
+
+public:
+  static const unsigned MaxIntervals = 4;
+
+  // Top
+  IntervalSet() : count(1) {
+  }
+
+  IntervalSet(const Range &r) : count(1) {
+    intervals[0] = r;
+    count = r.isBottom() ? 0 : 1;
+  }
+
+  IntervalSet operator+(const IntervalSet &rhs) const;
+  IntervalSet operator-(const IntervalSet &rhs) const;
+  IntervalSet operator*(const IntervalSet &rhs) const;
+  IntervalSet operator/(const IntervalSet &rhs) const;
+  IntervalSet operator|(const IntervalSet &rhs) const;
+  IntervalSet operator&(const IntervalSet &rhs) const;
+  bool operator==(const IntervalSet &rhs) const;
+
+  bool operator!=(const IntervalSet &rhs) const {
+    return !(*this == rhs);
+  }
+
+  // Widening is applied to the hull: the intervals of a loop header phi
+  // are merged once its bounds start growing, so that the thresholds
+  // bound the number of steps as for Range.
+  IntervalSet widen(const IntervalSet &next, const std::vector<double> &thresholds) const;
+
+  // Smallest range containing all the intervals
+  Range getRange() const;
+
+  inline bool isBottom() const {
+    return count == 0;
+  }
+
+  inline unsigned size() const {
+    return count;
+  }
+
+  inline const Range &getInterval(unsigned idx) const {
+    return intervals[idx];
+  }
+
+  static IntervalSet Bottom() {
+    return IntervalSet(Range::Bottom());
+  }
+
+private:
+  Range intervals[MaxIntervals];
+  unsigned count;
+
+  enum Operation {
+    Add, Sub, Mul, Div
+  };
+
+  IntervalSet apply(Operation op, const IntervalSet &rhs) const;
+
+  // Set of the (possibly overlapping and unsorted) ranges, which are
+  // modified
+  static IntervalSet fromRanges(Range *ranges, unsigned n);
+};
+
+}
+
+#endif
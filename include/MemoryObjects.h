@@ -0,0 +1,83 @@
+#ifndef CTO_MEMORY_OBJECTS_H_
+#define CTO_MEMORY_OBJECTS_H_
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Value.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include "Range.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace cto {
+
+// Memory holding floating point values (scalars or arrays of them) whose
+// accesses are all known: the allocas and the internal globals used only
+// by the function, through loads, stores and getelementptrs, and the
+// constant globals. The pointers to such an object are never stored,
+// merged or passed to calls, so that no other object aliases it. The
+// elements of an object share a single summary: an array (e.g. a delay
+// line, or the coefficients of a filter) gets a range as a whole.
+class MemoryObjects {
+public:
+  static const unsigned NotTracked = ~0U;
+
+  struct Object {
+    // AllocaInst or GlobalVariable
+    llvm::Value *Base;
+    // Range of the values held before the stores of the function: the
+    // initializer, and the values copied or set by the memory intrinsics
+    // (Bottom if there are none)
+    cto::Range Initial;
+    std::vector<llvm::LoadInst *> Loads;
+    std::vector<llvm::StoreInst *> Stores;
+    // Zeroing memsets of the object
+    std::vector<llvm::MemSetInst *> Clears;
+    // Whether the object is an alloca accessed only by the instructions
+    // above, so that it can be replaced by an integer buffer
+    bool Rewritable;
+
+    Object(llvm::Value *base, const cto::Range &initial) :
+      Base(base), Initial(initial), Rewritable(false) {
+    }
+  };
+
+  // The internal globals written by the function are only tracked with
+  // writableGlobals: their loads read the stores of the previous calls,
+  // which are only covered by an analysis of the function in the context
+  // of all its calls (not by the one of each calling context).
+  void compute(llvm::Function &F, bool writableGlobals);
+
+  // Object accessed by a load or a store, or NotTracked
+  inline unsigned lookup(const llvm::Value *access) const {
+    llvm::DenseMap<const llvm::Value *, unsigned>::const_iterator found = accesses.find(access);
+    return found != accesses.end() ? found->second : NotTracked;
+  }
+
+  inline const Object &getObject(unsigned idx) const {
+    return objects[idx];
+  }
+
+  inline unsigned size() const {
+    return objects.size();
+  }
+
+  void swap(MemoryObjects &other) {
+    objects.swap(other.objects);
+    accesses.swap(other.accesses);
+  }
+
+private:
+  std::vector<Object> objects;
+  llvm::DenseMap<const llvm::Value *, unsigned> accesses;
+
+  void addObject(llvm::Value *base, llvm::Type *type, const cto::Range &initial,
+                 llvm::Function &F);
+};
+
+}
+
+#endif
@@ -83,6 +83,15 @@ inline OptionalValue<double> max(const OptionalValue<double> &x, const OptionalV
   return OptionalValue<double>::invalid();
 }
 
+// Invalid values are unbounded, so the other value is the smallest
+template <typename T>
+OptionalValue<T> min(const OptionalValue<T> &x, const OptionalValue<T> &y) {
+  if (x.isValid() && y.isValid()) {
+    return x.get() < y.get() ? x : y;
+  }
+  return x.isValid() ? x : y;
+}
+
 inline OptionalValue<double> pow(const OptionalValue<double> &x, const double y) {
   if (x.isValid())
     return OptionalValue<double>(std::pow(x.get(), y));
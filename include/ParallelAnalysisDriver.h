@@ -0,0 +1,76 @@
+#ifndef CTO_PARALLEL_ANALYSIS_DRIVER_H_
+#define CTO_PARALLEL_ANALYSIS_DRIVER_H_
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Function.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+
+#include "FloatRangeAnalysis.h"
+#include "PrecisionAnalysis.h"
+#include "TripCounts.h"
+
+#include <vector>
+
+namespace cto {
+
+// Runs FloatRangeAnalysis and PrecisionAnalysis on all the functions of the
+// module, distributing the functions over a pool of threads. The function
+// passes scheduled afterwards (e.g. -float2fix) adopt the precomputed results
+// instead of analyzing each function again.
+struct ParallelAnalysisDriver : public llvm::ModulePass {
+  static char ID;
+
+  ParallelAnalysisDriver() : llvm::ModulePass(ID) {
+  }
+  virtual ~ParallelAnalysisDriver();
+
+  virtual bool runOnModule(llvm::Module &M);
+
+  // The results not taken yet are dropped with the analysis
+  virtual void releaseMemory() {
+    clearJobs();
+  }
+
+  virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const {
+    AU.addRequired<llvm::LoopInfo>();
+    AU.addRequired<llvm::ScalarEvolution>();
+    AU.setPreservesAll();
+  }
+
+  // Move the results computed for F into the given tables. Return false if
+  // F was not analyzed, or if it changed after the analysis (its structural
+  // hash, see ResultCache, is compared).
+  bool takeRanges(const llvm::Function &F, FunctionRanges &ranges);
+  bool takeErrors(const llvm::Function &F, FunctionErrors &errors);
+
+  // Analysis of a single function, run by one of the threads
+  struct Job {
+    llvm::Function *F;
+    uint64_t Key;
+    const input_ranges_t *Inputs;
+    TripCounts TC;
+    FunctionRanges Ranges;
+    FunctionErrors Errors;
+    double Seconds;
+    bool RangesTaken;
+
+    Job(llvm::Function *F, uint64_t Key) :
+      F(F), Key(Key), Inputs(NULL), Seconds(0.0),
+      RangesTaken(false) {
+    }
+  };
+
+private:
+  std::vector<Job *> jobs;
+  llvm::DenseMap<const llvm::Function *, Job *> jobIndex;
+
+  Job *findJob(const llvm::Function &F) const;
+  void clearJobs();
+};
+
+}
+
+#endif
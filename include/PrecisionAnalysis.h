@@ -6,23 +6,59 @@
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 
+#include "AnalysisArena.h"
+#include "FixedPointFormat.h"
 #include "OptionalValue.h"
+#include "ResultTable.h"
+#include "TripCounts.h"
 
 #include "FloatRangeAnalysis.h"
 
-#define WORD_LENGTH 64
+#include <algorithm>
+#include <map>
 
 namespace cto {
 
+typedef ResultTable<OptionalValue<double> > error_store_t;
+
+// Errors computed for a single function, indexed as the ranges computed by
+// FloatRangeAnalysis
+struct FunctionErrors {
+  error_store_t Errors;
+  // Largest error of each value over all the iterations of the loops
+  error_store_t Peaks;
+  OptionalValue<double> MaxError;
+  // Fractional bits of the values with the widest range (each value has
+  // its own fixed point format, see FixedPointFormat.h)
+  uint64_t DecimalBitWidth;
+  // Generation of the ranges the errors were computed from
+  unsigned RangesGeneration;
+
+  FunctionErrors() : MaxError(OptionalValue<double>::invalid()), DecimalBitWidth(0),
+    RangesGeneration(0) {
+  }
+
+  void swap(FunctionErrors &other) {
+    Errors.swap(other.Errors);
+    Peaks.swap(other.Peaks);
+    std::swap(MaxError, other.MaxError);
+    std::swap(DecimalBitWidth, other.DecimalBitWidth);
+    std::swap(RangesGeneration, other.RangesGeneration);
+  }
+};
+
 struct PrecisionAnalysis : public llvm::FunctionPass {
   static char ID;
 
-  PrecisionAnalysis() : llvm::FunctionPass(ID) {
+  PrecisionAnalysis() : llvm::FunctionPass(ID), Errors(NULL) {
 
   }
 
   virtual bool runOnFunction(llvm::Function &F);
 
+  // As for FloatRangeAnalysis
+  virtual void releaseMemory();
+
   virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const {
     AU.addRequired<FloatRangeAnalysis>();
     AU.addRequired<llvm::LoopInfo>();
@@ -36,10 +72,36 @@ struct PrecisionAnalysis : public llvm::FunctionPass {
 
   uint64_t getInternalDBW(const llvm::Function &F) const;
 
+  // Fractional bits of a value, given the bits of its integer part
+  static uint64_t computeInternalDBW(OptionalValue<uint64_t> integerBitWidth);
+
+  // Analyze F outside of the pass manager, using the ranges computed by
+  // FloatRangeAnalysis::computeRanges. As for the ranges, different
+  // functions can be analyzed concurrently, each with its own arena.
+  static void computeErrors(llvm::Function &F,
+                            llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> &LI,
+                            const TripCounts &TC,
+                            const FunctionRanges &ranges,
+                            FunctionErrors &result,
+                            AnalysisArena *arena = NULL);
+
+  // Update the results of a previous analysis of F after its ranges were
+  // updated by FloatRangeAnalysis::updateRanges: only the errors of the
+  // values whose range was recomputed are recomputed as well.
+  static void updateErrors(llvm::Function &F,
+                           llvm::LoopInfoBase<llvm::BasicBlock, llvm::Loop> &LI,
+                           const TripCounts &TC,
+                           const FunctionRanges &ranges,
+                           FunctionErrors &result,
+                           AnalysisArena *arena = NULL);
+
   void printAll(const llvm::Function &F) const;
 
 private:
-  std::map<const llvm::Value *, OptionalValue<double> > errorMap;
+  // The results of each function are kept, as for FloatRangeAnalysis
+  std::map<const llvm::Function *, FunctionErrors> Results;
+  FunctionErrors *Errors;
+  AnalysisArena Arena;
   std::map<const llvm::Function *, OptionalValue<double> > maxErrors;
 
 };
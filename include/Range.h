@@ -1,7 +1,9 @@
 #ifndef CTO_RANGE_H_
 #define CTO_RANGE_H_
 
+#include <cmath>
 #include <ostream>
+#include <vector>
 #include "llvm/Support/raw_ostream.h"
 
 namespace cto {
@@ -11,66 +13,78 @@ class Range {
   friend llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const Range &obj);
 
 public:
+  // Top and Bottom are encoded in the bounds: Top is [-inf, +inf] and Bottom
+  // is [+inf, -inf] (any range with min > max is Bottom). Bounds that are
+  // not a number are unknown, thus widened to the infinities.
 
-  Range() : valid(false), bottom(false), min(0), max(0) {
+  Range() : min(-HUGE_VAL), max(HUGE_VAL) {
   }
 
-  Range(double k) : valid(true), bottom(false), min(k), max(k) {
+  Range(double k) : min(k), max(k) {
+    normalize();
   }
 
-  Range(double min, double max) : valid(true), bottom(false), min(min), max(max) {
-    if (min > max) {
-      // To avoid breaking too many things, bottom is an INVALID range
-      // with min and max equal to 0.0 (thus it has the minimum possible integer bitwidth);
-      // differently than Top it propagates to arithmetic operators, but not to
-      // the OR operation.
-      min = 0.0;
-      max = 0.0;
-      valid = false;
-      bottom = true;
-    }
+  Range(double min, double max) : min(min), max(max) {
+    normalize();
   }
 
-  Range operator+(const Range &rhs);
-  Range operator-(const Range &rhs);
-  Range operator*(const Range &rhs);
-  Range operator/(const Range &rhs);
-  Range operator|(const Range &rhs);
-  Range operator&(const Range &rhs);
+  // Bottom propagates to the arithmetic operators, but not to the OR
+  // operation. Division by a range containing zero gives Top.
+  Range operator+(const Range &rhs) const;
+  Range operator-(const Range &rhs) const;
+  Range operator*(const Range &rhs) const;
+  Range operator/(const Range &rhs) const;
+  Range operator|(const Range &rhs) const;
+  Range operator&(const Range &rhs) const;
   bool operator==(const Range &rhs) const;
+
+  // Widening: a bound that grew with respect to this range is moved to the
+  // closest of the (sorted) thresholds, or to Top if none is large enough.
+  Range widen(const Range &next, const std::vector<double> &thresholds) const;
+
   bool operator!=(const Range &rhs) const {
     return !(*this == rhs);
   }
 
-  inline bool isValid() {
-    return valid;
+  // Strict ordering consistent with ==, to use ranges as keys
+  bool operator<(const Range &rhs) const;
+
+  inline bool isValid() const {
+    return min <= max && (min != -HUGE_VAL || max != HUGE_VAL);
+  }
+
+  inline bool isBottom() const {
+    return min > max;
   }
 
-  inline bool isBottom() {
-    return bottom;
+  inline bool contains(double k) const {
+    return min <= k && k <= max;
   }
 
-  inline double getMin() {
+  inline double getMin() const {
     return min;
   }
 
-  inline double getMax() {
+  inline double getMax() const {
     return max;
   }
 
-  static Range Top;
+  static const Range Top;
   static Range Bottom() {
-    Range r;
-    r.bottom = true;
-    return r;
+    return Range(HUGE_VAL, -HUGE_VAL);
   }
 
 private:
-  bool valid;
-  bool bottom;
   double min;
   double max;
 
+  inline void normalize() {
+    min = min != min ? -HUGE_VAL : min;
+    max = max != max ? HUGE_VAL : max;
+    bool empty = min > max;
+    min = empty ? HUGE_VAL : min;
+    max = empty ? -HUGE_VAL : max;
+  }
 };
 
 }
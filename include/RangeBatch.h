@@ -0,0 +1,59 @@
+#ifndef CTO_RANGE_BATCH_H_
+#define CTO_RANGE_BATCH_H_
+
+#include "Range.h"
+
+#include <vector>
+
+namespace cto {
+
+// Interval operations evaluated on many pairs of ranges at once. The bounds
+// are kept as a structure of arrays, so that the operations are evaluated
+// with SSE2 or AVX (when the compiler targets them) on several ranges per
+// instruction. Bottom, and divisors containing zero, cannot be added, as
+// they are handled by the scalar operators of Range; otherwise the results
+// are the same as theirs.
+class RangeBatch {
+public:
+  enum Operation {
+    Add, Sub, Mul, Div, Join, Meet
+  };
+
+  inline void clear() {
+    lhsMin.clear();
+    lhsMax.clear();
+    rhsMin.clear();
+    rhsMax.clear();
+  }
+
+  inline unsigned size() const {
+    return lhsMin.size();
+  }
+
+  // Add a pair of operands, returning the index of its result
+  unsigned push(Range lhs, Range rhs) {
+    lhsMin.push_back(lhs.getMin());
+    lhsMax.push_back(lhs.getMax());
+    rhsMin.push_back(rhs.getMin());
+    rhsMax.push_back(rhs.getMax());
+    return lhsMin.size() - 1;
+  }
+
+  void evaluate(Operation op);
+
+  inline Range getResult(unsigned idx) const {
+    return Range(resMin[idx], resMax[idx]);
+  }
+
+private:
+  std::vector<double> lhsMin;
+  std::vector<double> lhsMax;
+  std::vector<double> rhsMin;
+  std::vector<double> rhsMax;
+  std::vector<double> resMin;
+  std::vector<double> resMax;
+};
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef CTO_RESULT_CACHE_H_
+#define CTO_RESULT_CACHE_H_
+
+#include "llvm/IR/Function.h"
+#include "llvm/Support/DataTypes.h"
+
+#include "FloatRangeAnalysis.h"
+#include "PrecisionAnalysis.h"
+#include "ValueNumbering.h"
+
+#include <map>
+#include <vector>
+
+namespace cto {
+
+// Persistent cache of the results of the range and precision analyses,
+// enabled with -float-range-cache=<directory>. The results of a function are
+// stored in compact binary files named after a key, i.e. a structural hash
+// of the function, of its input ranges and of the analysis options, and are
+// read back by mapping the files in memory.
+struct ResultCache {
+  // The last version of a function whose ranges were cached: the key of its
+  // results, and what updateRanges compares them with (the signatures of
+  // its values, and the known ranges by their number)
+  struct FunctionVersion {
+    uint64_t Key;
+    std::vector<uint64_t> Signatures;
+    std::map<unsigned, Range> KnownRanges;
+
+    FunctionVersion() : Key(0) {
+    }
+  };
+
+  static bool isEnabled();
+
+  // The key depends on the numbering of the values, as the tables do
+  static uint64_t computeKey(const llvm::Function &F,
+                             const ValueNumbering &numbering,
+                             const input_ranges_t *inputRanges);
+
+  // Structural hash of each instruction on its own (0 for the arguments):
+  // the operands are hashed by their number or their contents, never by
+  // their address, so that the hashes can be compared with the ones of a
+  // previous version of the function
+  static void computeSignatures(const llvm::Function &F,
+                                const ValueNumbering &numbering,
+                                std::vector<uint64_t> &signatures);
+
+  // Return false if there are no results for the key (or if they do not
+  // match the number of values)
+  static bool loadRanges(uint64_t key, unsigned numValues, range_store_t &store,
+                         OptionalValue<uint64_t> &minimumBits);
+  static bool loadErrors(uint64_t key, unsigned numValues, FunctionErrors &errors);
+
+  // Failures to write the cache are not errors, the results are simply
+  // computed again the next time
+  static void storeRanges(uint64_t key, const range_store_t &store,
+                          const OptionalValue<uint64_t> &minimumBits);
+  static void storeErrors(uint64_t key, const FunctionErrors &errors);
+
+  // The versions are found by the name of the function and of its module,
+  // and whether it is analyzed with input ranges
+  static bool loadVersion(const llvm::Function &F, bool inContext, FunctionVersion &version);
+  static void storeVersion(const llvm::Function &F, bool inContext,
+                           const FunctionVersion &version);
+};
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef CTO_RESULT_TABLE_H_
+#define CTO_RESULT_TABLE_H_
+
+#include "llvm/ADT/BitVector.h"
+
+#include <vector>
+
+namespace cto {
+
+// Contiguous table of analysis results, indexed by the ValueNumbering of the
+// function. The storage is reused across functions.
+template <typename T>
+class ResultTable {
+public:
+  void reset(unsigned size, const T &unknown) {
+    values.assign(size, unknown);
+    known.clear();
+    known.resize(size);
+  }
+
+  inline bool has(unsigned idx) const {
+    return idx < known.size() && known.test(idx);
+  }
+
+  inline const T &get(unsigned idx) const {
+    return values[idx];
+  }
+
+  inline void set(unsigned idx, const T &val) {
+    values[idx] = val;
+    known.set(idx);
+  }
+
+  inline void unset(unsigned idx) {
+    known.reset(idx);
+  }
+
+  inline unsigned size() const {
+    return values.size();
+  }
+
+  void swap(ResultTable &other) {
+    values.swap(other.values);
+    known.swap(other.known);
+  }
+
+private:
+  std::vector<T> values;
+  llvm::BitVector known;
+};
+
+}
+
+#endif
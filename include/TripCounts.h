@@ -0,0 +1,37 @@
+#ifndef CTO_TRIP_COUNTS_H_
+#define CTO_TRIP_COUNTS_H_
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include "OptionalValue.h"
+
+namespace cto {
+
+// Statically known maximum backedge-taken counts of the loops of a function.
+// They are computed once with ScalarEvolution and keyed by loop header, so
+// that the analysis algorithms do not need ScalarEvolution (which is neither
+// thread safe nor available outside of the pass manager) while they run.
+class TripCounts {
+public:
+  void compute(llvm::LoopInfo &LI, llvm::ScalarEvolution &SE);
+
+  OptionalValue<uint64_t> getBackedgeTakenCount(const llvm::Loop *loop) const {
+    llvm::DenseMap<const llvm::BasicBlock *, uint64_t>::const_iterator found =
+      counts.find(loop->getHeader());
+    if (found == counts.end()) {
+      return OptionalValue<uint64_t>::invalid();
+    }
+    return OptionalValue<uint64_t>(found->second);
+  }
+
+private:
+  llvm::DenseMap<const llvm::BasicBlock *, uint64_t> counts;
+
+  void addLoop(llvm::Loop *loop, llvm::ScalarEvolution &SE);
+};
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef CTO_VALUE_NUMBERING_H_
+#define CTO_VALUE_NUMBERING_H_
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Value.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace cto {
+
+// Dense numbering of the values defined in a function: the arguments come
+// first, followed by the instructions in reverse post-order of the CFG
+// (instructions in unreachable blocks are numbered last).
+// The numbers index the result tables shared by the analysis passes.
+class ValueNumbering {
+public:
+  static const unsigned NotNumbered = ~0U;
+
+  ValueNumbering() : numArguments(0) {
+  }
+
+  void number(llvm::Function &F);
+
+  inline unsigned lookup(const llvm::Value *val) const {
+    llvm::DenseMap<const llvm::Value *, unsigned>::const_iterator found = index.find(val);
+    return found != index.end() ? found->second : NotNumbered;
+  }
+
+  inline llvm::Value *getValue(unsigned idx) const {
+    return values[idx];
+  }
+
+  inline unsigned size() const {
+    return values.size();
+  }
+
+  inline unsigned getNumArguments() const {
+    return numArguments;
+  }
+
+  void swap(ValueNumbering &other) {
+    index.swap(other.index);
+    values.swap(other.values);
+    std::swap(numArguments, other.numArguments);
+  }
+
+private:
+  llvm::DenseMap<const llvm::Value *, unsigned> index;
+  std::vector<llvm::Value *> values;
+  unsigned numArguments;
+
+  void add(llvm::Value *val);
+  void numberBlock(llvm::BasicBlock &BB);
+};
+
+}
+
+#endif
@@ -0,0 +1,252 @@
+#include "AffineForm.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace cto;
+
+namespace {
+
+bool hasLargerCoefficient(const std::pair<unsigned, double> &a,
+                          const std::pair<unsigned, double> &b) {
+  return ::fabs(a.second) > ::fabs(b.second);
+}
+
+bool hasLowerSymbol(const std::pair<unsigned, double> &a,
+                    const std::pair<unsigned, double> &b) {
+  return a.first < b.first;
+}
+
+}
+
+AffineForm AffineForm::fromRange(const Range &r, unsigned symbol, NoiseSymbols *symbols) {
+  if (r.isBottom())
+    return Bottom();
+  AffineForm res(0.5 * r.getMin() + 0.5 * r.getMax());
+  res.terms.push_back(term_t(symbol, 0.5 * r.getMax() - 0.5 * r.getMin()));
+  res.symbols = symbols;
+  res.normalize();
+  return res;
+}
+
+bool AffineForm::getSpecialResult(const AffineForm &rhs, AffineForm &res) const {
+  if (isBottom() || rhs.isBottom()) {
+    res = Bottom();
+    return true;
+  }
+  if (isTop() || rhs.isTop()) {
+    res = AffineForm();
+    return true;
+  }
+  return false;
+}
+
+AffineForm AffineForm::combine(double a, const AffineForm &rhs, double b) const {
+  AffineForm res(a * center + b * rhs.center);
+  res.symbols = symbols != NULL ? symbols : rhs.symbols;
+  std::vector<term_t>::const_iterator x = terms.begin(), xe = terms.end();
+  std::vector<term_t>::const_iterator y = rhs.terms.begin(), ye = rhs.terms.end();
+  while (x != xe || y != ye) {
+    if (y == ye || (x != xe && x->first < y->first)) {
+      res.terms.push_back(term_t(x->first, a * x->second));
+      ++x;
+    } else if (x == xe || y->first < x->first) {
+      res.terms.push_back(term_t(y->first, b * y->second));
+      ++y;
+    } else {
+      // The symbols cancelling out are dropped, as in x - x
+      double coefficient = a * x->second + b * y->second;
+      if (coefficient != 0.0) {
+        res.terms.push_back(term_t(x->first, coefficient));
+      }
+      ++x;
+      ++y;
+    }
+  }
+  res.condense();
+  res.normalize();
+  return res;
+}
+
+void AffineForm::addNoise(double radius) {
+  if (radius == 0.0 || kind != Bounded)
+    return;
+  if (symbols == NULL) {
+    assert(false && "Fresh noise symbol needed without an allocator");
+    *this = AffineForm();
+    return;
+  }
+  term_t noise(symbols->fresh(), radius);
+  terms.insert(std::lower_bound(terms.begin(), terms.end(), noise, hasLowerSymbol), noise);
+  condense();
+}
+
+void AffineForm::condense() {
+  if (terms.size() <= MaxSymbols)
+    return;
+  std::sort(terms.begin(), terms.end(), hasLargerCoefficient);
+  double merged = 0.0;
+  for (unsigned i = MaxSymbols - 1; i < terms.size(); ++i) {
+    merged += ::fabs(terms[i].second);
+  }
+  terms.resize(MaxSymbols - 1);
+  std::sort(terms.begin(), terms.end(), hasLowerSymbol);
+  addNoise(merged);
+}
+
+void AffineForm::normalize() {
+  if (kind != Bounded)
+    return;
+  bool finite = ::fabs(center) < HUGE_VAL;
+  for (std::vector<term_t>::const_iterator it = terms.begin(), end = terms.end();
+       it != end; ++it) {
+    finite = finite && ::fabs(it->second) < HUGE_VAL;
+  }
+  if (!finite) {
+    *this = AffineForm();
+  }
+}
+
+double AffineForm::getRadius() const {
+  double radius = 0.0;
+  for (std::vector<term_t>::const_iterator it = terms.begin(), end = terms.end();
+       it != end; ++it) {
+    radius += ::fabs(it->second);
+  }
+  return radius;
+}
+
+Range AffineForm::getRange() const {
+  if (isBottom())
+    return Range::Bottom();
+  if (isTop())
+    return Range::Top;
+  double radius = getRadius();
+  return Range(center - radius, center + radius);
+}
+
+AffineForm AffineForm::operator+(const AffineForm &rhs) const {
+  AffineForm res;
+  if (getSpecialResult(rhs, res))
+    return res;
+  return combine(1.0, rhs, 1.0);
+}
+
+AffineForm AffineForm::operator-(const AffineForm &rhs) const {
+  AffineForm res;
+  if (getSpecialResult(rhs, res))
+    return res;
+  return combine(1.0, rhs, -1.0);
+}
+
+// x * y = x0 y0 + sum (y0 xi + x0 yi) ei + e, with |e| <= rad(x) rad(y)
+AffineForm AffineForm::operator*(const AffineForm &rhs) const {
+  AffineForm res;
+  if (getSpecialResult(rhs, res))
+    return res;
+  res = combine(rhs.center, rhs, center);
+  res.center -= center * rhs.center;
+  res.addNoise(getRadius() * rhs.getRadius());
+  res.normalize();
+  return res;
+}
+
+AffineForm AffineForm::operator/(const AffineForm &rhs) const {
+  AffineForm res;
+  if (getSpecialResult(rhs, res))
+    return res;
+  if (rhs.terms.empty()) {
+    if (rhs.center == 0.0)
+      return AffineForm();
+    return combine(1.0 / rhs.center, AffineForm(0.0), 0.0);
+  }
+  return *this * rhs.reciprocal();
+}
+
+// Min-range approximation of 1 / y on [a, b], 0 < a: the line with the slope
+// of 1 / y in b, alpha = -1 / b^2, and the error 1 / y - alpha y, which is
+// decreasing, thus in [2 / b, 1 / a + a / b^2]
+AffineForm AffineForm::reciprocal() const {
+  Range r = getRange();
+  if (!r.isValid() || r.contains(0.0))
+    return AffineForm();
+  if (r.getMax() < 0.0)
+    return AffineForm(0.0) - (AffineForm(0.0) - *this).reciprocal();
+  double a = r.getMin();
+  double b = r.getMax();
+  double alpha = -1.0 / (b * b);
+  double lo = 2.0 / b;
+  double hi = 1.0 / a + a / (b * b);
+  AffineForm res = combine(alpha, AffineForm(0.5 * lo + 0.5 * hi), 1.0);
+  res.addNoise(0.5 * hi - 0.5 * lo);
+  res.normalize();
+  return res;
+}
+
+AffineForm AffineForm::operator|(const AffineForm &rhs) const {
+  if (isBottom())
+    return rhs;
+  if (rhs.isBottom())
+    return *this;
+  if (isTop() || rhs.isTop())
+    return AffineForm();
+
+  AffineForm res(0.0);
+  res.symbols = symbols != NULL ? symbols : rhs.symbols;
+  // Radius of the terms each form does not share with the other one
+  double radius = 0.0;
+  double rhsRadius = 0.0;
+  std::vector<term_t>::const_iterator x = terms.begin(), xe = terms.end();
+  std::vector<term_t>::const_iterator y = rhs.terms.begin(), ye = rhs.terms.end();
+  while (x != xe || y != ye) {
+    if (y == ye || (x != xe && x->first < y->first)) {
+      radius += ::fabs(x->second);
+      ++x;
+    } else if (x == xe || y->first < x->first) {
+      rhsRadius += ::fabs(y->second);
+      ++y;
+    } else {
+      if (x->second == y->second) {
+        res.terms.push_back(*x);
+      } else {
+        radius += ::fabs(x->second);
+        rhsRadius += ::fabs(y->second);
+      }
+      ++x;
+      ++y;
+    }
+  }
+  double lo = ::fmin(center - radius, rhs.center - rhsRadius);
+  double hi = ::fmax(center + radius, rhs.center + rhsRadius);
+  res.center = 0.5 * lo + 0.5 * hi;
+  res.addNoise(0.5 * hi - 0.5 * lo);
+  res.normalize();
+  return res;
+}
+
+bool AffineForm::operator==(const AffineForm &rhs) const {
+  if (kind != Bounded || rhs.kind != Bounded)
+    return kind == rhs.kind;
+  return center == rhs.center && terms == rhs.terms;
+}
+
+namespace cto {
+
+std::ostream &operator<<(std::ostream &os, const AffineForm &obj) {
+  os << obj.getRange();
+  if (!obj.terms.empty()) {
+    os << '{' << obj.terms.size() << '}';
+  }
+  return os;
+}
+
+llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const AffineForm &obj) {
+  os << obj.getRange();
+  if (!obj.terms.empty()) {
+    os << '{' << obj.terms.size() << '}';
+  }
+  return os;
+}
+
+}
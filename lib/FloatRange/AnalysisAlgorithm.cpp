@@ -1,128 +1,158 @@
 #include "AnalysisAlgorithm.h"
 
-#include "Range.h"
-#include "OptionalValue.h"
-
-#include "llvm/Analysis/ScalarEvolutionExpressions.h"
-
-#include <set>
-#include <queue>
-#include <map>
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 using namespace cto;
 
-template <typename T>
-void AnalysisAlgorithm<T>::Worklist::enqueue(llvm::Instruction *val) {
-  // Do not add elements to the Worklist multiple times
-  if (contained.find(val) != contained.end()) {
-    return;
-  }
-  contained.insert(val);
-  impl.push(val);
+static cl::opt<bool> UseWidening("analysis-widening", cl::init(false),
+    cl::desc("Analyze loops with widening and narrowing until a fixpoint is "
+             "reached, instead of visiting each instruction once per "
+             "iteration of the loop (also handles unknown tripcounts)."));
+static cl::opt<unsigned> WideningDelay("analysis-widening-delay", cl::init(2),
+    cl::desc("Number of visits of a loop header phi before widening "
+             "is applied to it."));
+static cl::opt<unsigned> NarrowingSteps("analysis-narrowing-steps", cl::init(2),
+    cl::desc("Maximum number of narrowing sweeps performed after the "
+             "widening fixpoint is reached."));
+static cl::opt<RangeDomain> Domain("float-range-domain", cl::init(IntervalDomain),
+    cl::desc("Abstract domain of the range analysis:"),
+    cl::values(
+      clEnumValN(IntervalDomain, "interval", "a single range per value"),
+      clEnumValN(IntervalSetDomain, "interval-set",
+                 "a union of disjoint ranges per value, intersected with the "
+                 "single range"),
+      clEnumValN(AffineDomain, "affine",
+                 "affine forms keeping the correlations between the values, "
+                 "intersected with the single range (also used for the errors)"),
+      clEnumValEnd));
+
+std::string cto::getAnalysisConfiguration() {
+  std::string res;
+  raw_string_ostream os(res);
+  os << "widening=" << (UseWidening ? 1 : 0)
+     << ";delay=" << static_cast<unsigned>(WideningDelay)
+     << ";narrowing=" << static_cast<unsigned>(NarrowingSteps)
+     << ";domain=" << static_cast<unsigned>(Domain);
+  return os.str();
 }
 
-template <typename T>
-llvm::Instruction *AnalysisAlgorithm<T>::Worklist::dequeue() {
-  assert(!isEmpty() && "dequeue called on an empty worklist");
-  Instruction *val = impl.front();
-  contained.erase(val);
-  impl.pop();
-  return val;
+bool cto::isWideningEnabled() {
+  return UseWidening;
 }
 
-template <typename T>
-T AnalysisAlgorithm<T>::visit(llvm::Instruction *inst) {
-  if (isa<llvm::BinaryOperator>(inst)) {
-    BinaryOperator *bop = dyn_cast < BinaryOperator > (inst);
-    BinaryOperator::BinaryOps opcode = bop->getOpcode();
-    switch (opcode) {
-    case BinaryOperator::FAdd:
-      return visitFAdd(*bop);
-      break;
-    case BinaryOperator::FSub:
-      return visitFSub(*bop);
-      break;
-    case BinaryOperator::FMul:
-      return visitFMul(*bop);
-      break;
-    case BinaryOperator::FDiv:
-      return visitFDiv(*bop);
-      break;
-    default:
-      break;
-    }
-  } else if (isa < PHINode > (inst)) {
-    PHINode *phi = dyn_cast < PHINode > (inst);
-    return visitPhi(*phi);
-  }
-  report_fatal_error("Attempting to visit an unsupported instruction");
-  return getUnboundedResult();
+unsigned cto::getWideningDelay() {
+  return WideningDelay;
 }
 
-template <typename T>
-void AnalysisAlgorithm<T>::analyze(const inst_iterator &begin,
-		const inst_iterator &end) {
-  for (inst_iterator it = begin; it != end; ++it) {
-    wl.enqueue(&(*it));
-  }
-
-  while (!wl.isEmpty()) {
-    Instruction *cur = wl.dequeue();
+unsigned cto::getNarrowingSteps() {
+  return NarrowingSteps;
+}
 
-    // Ensure that the instruction is supported
-    if (!isSupported(cur)) {
-      continue;
-    }
+RangeDomain cto::getRangeDomain() {
+  return Domain;
+}
 
-    // If we are in a loop, ensure we process each instruction at most the
-    // tripcount, if it is statically known, or the maximum number of iterations
-    // Note that this might produce incorrect results for complex structures
-    // even though the tripcount is known!
-    Loop *loop = loopInfo.getLoopFor(cur->getParent());
-    if (loop != NULL) {
-      const SCEVConstant *CC = dyn_cast<SCEVConstant>(scev.getMaxBackedgeTakenCount(loop));
-      if (CC != NULL) {
-        unsigned tripCount = CC->getValue()->getValue().getZExtValue();
-        if (counter[cur] >= tripCount) {
-          continue;
-        }
-      } else {
-        // Loops with unknown tripcount are not supported.
-    	// Default to unbounded value.
-        // Don't check if the insertion succeeded, we are guaranteed
-    	// that this is the first time we've seen this Value*.
-        resultSet.insert(std::make_pair<Value *, T>(cur, getUnboundedResult()));
-        continue;
-      }
+MathFunction cto::getMathFunction(const CallInst &call) {
+  const Function *callee = call.getCalledFunction();
+  if (callee == NULL || !call.getType()->isFloatingPointTy())
+    return NotMathFunction;
+
+  MathFunction fn = NotMathFunction;
+  unsigned numArgs = 0;
+  StringRef name = callee->getName();
+  switch (callee->getIntrinsicID()) {
+  case Intrinsic::fabs:
+    fn = Fabs;
+    break;
+  case Intrinsic::sqrt:
+    fn = Sqrt;
+    break;
+  case Intrinsic::fma:
+  case Intrinsic::fmuladd:
+    fn = FMulAdd;
+    break;
+  case Intrinsic::not_intrinsic:
+    // Only the declarations: a definition with the same name is not libm
+    if (!callee->isDeclaration())
+      break;
+    if (name == "fabs" || name == "fabsf") {
+      fn = Fabs;
+    } else if (name == "sqrt" || name == "sqrtf") {
+      fn = Sqrt;
+    } else if (name == "fma" || name == "fmaf") {
+      fn = FMulAdd;
+    } else if (name == "fmin" || name == "fminf") {
+      fn = FMin;
+    } else if (name == "fmax" || name == "fmaxf") {
+      fn = FMax;
     }
+    break;
+  default:
+    break;
+  }
 
-#ifdef TRACE_VISITING
-    errs() << "Visiting ";
-    cur->print(errs());
-    errs() << "\n";
-#endif
-
-    T result = visit(cur);
+  switch (fn) {
+  case Fabs:
+  case Sqrt:
+    numArgs = 1;
+    break;
+  case FMin:
+  case FMax:
+    numArgs = 2;
+    break;
+  case FMulAdd:
+    numArgs = 3;
+    break;
+  default:
+    return NotMathFunction;
+  }
+  if (call.getNumArgOperands() != numArgs)
+    return NotMathFunction;
+  for (unsigned i = 0; i < numArgs; ++i) {
+    if (call.getArgOperand(i)->getType() != call.getType())
+      return NotMathFunction;
+  }
+  return fn;
+}
 
-    for (Value::use_iterator u = cur->use_begin(), e = cur->use_end();
-         u != e; ++u) {
-      if (isa<Instruction>(*u)) {
-        wl.enqueue(dyn_cast<Instruction>(*u));
-      } else {
-        report_fatal_error("Found uses that are not instructions. This is unsupported.");
-      }
-    }
+bool cto::isCastSupported(const CastInst &cast) {
+  if (!cast.getType()->isFPOrFPVectorTy())
+    return false;
+  switch (cast.getOpcode()) {
+  case Instruction::FPExt:
+  case Instruction::FPTrunc:
+    return true;
+  case Instruction::SIToFP:
+  case Instruction::UIToFP:
+    return cast.getOperand(0)->getType()->isIntOrIntVectorTy();
+  default:
+    return false;
+  }
+}
 
-    std::pair<typename result_set_t::iterator, bool> res =
-      resultSet.insert(std::make_pair<Value *, T>(cur, result));
-    if (!res.second) {
-      res.first->second = result;
+bool cto::getConstantRange(const Value *val, Range &res) {
+  if (const ConstantFP *CFP = dyn_cast<ConstantFP>(val)) {
+    res = Range(CFP->getValueAPF().convertToDouble());
+    return true;
+  }
+  const Constant *C = dyn_cast<Constant>(val);
+  VectorType *type = dyn_cast<VectorType>(val->getType());
+  if (C == NULL || type == NULL || !type->getElementType()->isFloatingPointTy())
+    return false;
+  res = Range::Bottom();
+  for (unsigned i = 0; i < type->getNumElements(); ++i) {
+    const Constant *lane = C->getAggregateElement(i);
+    if (const ConstantFP *CFP = dyn_cast_or_null<ConstantFP>(lane)) {
+      res = res | Range(CFP->getValueAPF().convertToDouble());
+    } else if (lane == NULL || !isa<UndefValue>(lane)) {
+      // A constant expression
+      res = Range::Top;
+      return true;
     }
-    counter[cur]++;
   }
+  return true;
 }
-
-// Force explicit instantiation of template class
-template class AnalysisAlgorithm<OptionalValue<double> >;
-template class AnalysisAlgorithm<Range >;
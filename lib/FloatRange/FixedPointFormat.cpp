@@ -0,0 +1,190 @@
+#include "FixedPointFormat.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace llvm;
+using namespace cto;
+
+static cl::opt<unsigned> DecimalPrecision("precision-bitwidth", cl::init(16),
+    cl::desc("float2fix: Precision requested for the decimal part in order"
+             "to enable conversion to fixed point. This is expressed as"
+             "the number of \"equivalent\" decimal bits."
+             "For this optionto take effect, the PrecisionAnalyis pass"
+             "should be executed before the float2fix-analysis pass."));
+static cl::opt<bool> Narrowing("fixed-point-narrowing", cl::init(false),
+    cl::desc("float2fix: Store each value in the narrowest integer (8, 16, "
+             "32 or 64 bits) keeping the precision requested with "
+             "-precision-bitwidth, instead of always using 64 bits."));
+
+// Fractional bits kept beyond the requested ones by the narrowed values
+static const unsigned NarrowingGuardBits = 4;
+
+bool cto::isNarrowingEnabled() {
+  return Narrowing;
+}
+
+unsigned cto::getRequestedPrecision() {
+  return DecimalPrecision;
+}
+
+std::string cto::getFormatConfiguration() {
+  std::string res;
+  raw_string_ostream os(res);
+  os << "narrowing=" << (Narrowing ? 1 : 0)
+     << ";precision=" << static_cast<unsigned>(DecimalPrecision);
+  return os.str();
+}
+
+unsigned cto::getContainingWidth(int bits) {
+  for (unsigned width = 8; width < 2 * WORD_LENGTH; width *= 2) {
+    if (bits <= static_cast<int>(width)) {
+      return width;
+    }
+  }
+  return 2 * WORD_LENGTH;
+}
+
+OptionalValue<uint64_t> cto::getIntegerBits(const Range &r) {
+  if (r.isBottom()) {
+    return OptionalValue<uint64_t>(0);
+  }
+  if (!r.isValid()) {
+    return OptionalValue<uint64_t>::invalid();
+  }
+  // Note: we assume a two's complement fixed point representation as a target.
+  // ceil() is because the approximation of the decimal part may add one unit to the integer part
+  // The "+1" if get{Min,Max}() is positive is because two's complement representation
+  // has the range [-2^N, +2^N-1].
+  double rmin = ::ceil(r.getMin() < 0 ? ::fabs(r.getMin()) : r.getMin() + 1);
+  double rmax = ::ceil(r.getMax() < 0 ? ::fabs(r.getMax()) : r.getMax() + 1);
+  return OptionalValue<uint64_t>(static_cast<uint64_t>(::ceil(::log2(::fmax(rmin, rmax))) + 1));
+}
+
+unsigned cto::getStorageWidth(OptionalValue<uint64_t> integerBits) {
+  if (!Narrowing || !integerBits.isValid() || integerBits.get() >= WORD_LENGTH) {
+    return WORD_LENGTH;
+  }
+  int bits = static_cast<int>(integerBits.get() + DecimalPrecision + NarrowingGuardBits);
+  return bits < WORD_LENGTH ? getContainingWidth(bits) : WORD_LENGTH;
+}
+
+int cto::getFractionalBits(OptionalValue<uint64_t> integerBits) {
+  if (!integerBits.isValid() || integerBits.get() >= WORD_LENGTH) {
+    return 0;
+  }
+  unsigned width = getStorageWidth(integerBits);
+  if (width < WORD_LENGTH) {
+    return static_cast<int>(width - integerBits.get());
+  }
+  return static_cast<int>(WORD_LENGTH - 1 - integerBits.get());
+}
+
+double cto::getAlignmentError(int from, int to) {
+  return from > to ? ::ldexp(1.0, -to) : 0.0;
+}
+
+ProductLowering::ProductLowering(int f1, int f2, OptionalValue<uint64_t> integerBits) :
+  Shift1(0), Shift2(0), Fraction(f1 + f2) {
+  int bits = integerBits.isValid() ? static_cast<int>(integerBits.get()) : WORD_LENGTH;
+  int excess = f1 + f2 + bits - 2 * WORD_LENGTH;
+  if (excess <= 0) {
+    return;
+  }
+  // Bring the operands to the same format, then drop the bits of both
+  int difference = std::min(excess, f1 > f2 ? f1 - f2 : f2 - f1);
+  int rest = excess - difference;
+  if (f1 >= f2) {
+    Shift1 = difference + (rest + 1) / 2;
+    Shift2 = rest / 2;
+  } else {
+    Shift1 = rest / 2;
+    Shift2 = difference + (rest + 1) / 2;
+  }
+  Fraction -= excess;
+}
+
+QuotientLowering::QuotientLowering(int f1, int f2, int result,
+                                   OptionalValue<uint64_t> dividendBits) {
+  int bits = dividendBits.isValid() ? static_cast<int>(dividendBits.get()) : WORD_LENGTH;
+  Shift = std::min(result + f2 - f1, 2 * WORD_LENGTH - bits - f1);
+  Fraction = f1 + Shift - f2;
+}
+
+bool FixedPointFormats::getReciprocalLowering(const BinaryOperator &div,
+                                              const LoopInfoBase<BasicBlock, Loop> &LI,
+                                              ReciprocalLowering &res) const {
+  const Value *divisor = div.getOperand(1);
+  Range r = ranges.getRange(divisor);
+  if (uniform || !r.isValid() || r.isBottom() || r.contains(0.0)) {
+    return false;
+  }
+  res.Preheader = NULL;
+  if (!isa<Constant>(divisor)) {
+    // Its fixed point value must stay away from zero as well
+    double low = std::min(::fabs(r.getMin()), ::fabs(r.getMax()));
+    if (::ldexp(low, getFormat(divisor)) < 2.0) {
+      return false;
+    }
+    const Instruction *def = dyn_cast<Instruction>(divisor);
+    for (Loop *loop = LI.getLoopFor(div.getParent());
+         loop != NULL && (def == NULL || !loop->contains(def->getParent()));
+         loop = loop->getParentLoop()) {
+      if (loop->getLoopPreheader() == NULL) {
+        break;
+      }
+      res.Preheader = loop->getLoopPreheader();
+    }
+    if (res.Preheader == NULL) {
+      return false;
+    }
+  }
+  // The reciprocal is kept in a word, whatever the narrowing: the one of a
+  // value is then 2^(Fraction + f) / x, whose dividend fits a double word
+  res.IntegerBits = cto::getIntegerBits(Range(1.0) / r);
+  if (!res.IntegerBits.isValid() || res.IntegerBits.get() >= WORD_LENGTH - 1) {
+    return false;
+  }
+  res.Fraction = std::min(static_cast<int>(WORD_LENGTH - 1 - res.IntegerBits.get()),
+                          2 * WORD_LENGTH - 2 - getFormat(divisor));
+  return true;
+}
+
+int FixedPointFormats::getObjectFormat(unsigned object) const {
+  const MemoryObjects::Object &obj = ranges.Memory.getObject(object);
+  int format = WORD_LENGTH;
+  for (std::vector<LoadInst *>::const_iterator it = obj.Loads.begin(), end = obj.Loads.end();
+       it != end; ++it) {
+    format = std::min(format, getFormat(*it));
+  }
+  for (std::vector<StoreInst *>::const_iterator it = obj.Stores.begin(), end = obj.Stores.end();
+       it != end; ++it) {
+    format = std::min(format, getFormat(*it));
+  }
+  return format;
+}
+
+static int getBitsOrWord(OptionalValue<uint64_t> integerBits) {
+  return integerBits.isValid() ? static_cast<int>(integerBits.get()) : WORD_LENGTH;
+}
+
+unsigned FixedPointFormats::getObjectWidth(unsigned object) const {
+  if (uniform || !Narrowing) {
+    return WORD_LENGTH;
+  }
+  // Wide enough for the largest value at the shared format
+  const MemoryObjects::Object &obj = ranges.Memory.getObject(object);
+  int bits = 0;
+  for (std::vector<LoadInst *>::const_iterator it = obj.Loads.begin(), end = obj.Loads.end();
+       it != end; ++it) {
+    bits = std::max(bits, getBitsOrWord(getIntegerBits(*it)));
+  }
+  for (std::vector<StoreInst *>::const_iterator it = obj.Stores.begin(), end = obj.Stores.end();
+       it != end; ++it) {
+    bits = std::max(bits, getBitsOrWord(getIntegerBits(*it)));
+  }
+  return getContainingWidth(bits + getObjectFormat(object));
+}
@@ -1,14 +1,22 @@
 #define DEBUG_TYPE "float2fix"
 
+#include "AnalysisAlgorithm.h"
+#include "FixedPointFormat.h"
 #include "PrecisionAnalysis.h"
 
 #include "llvm/Pass.h"
 #include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/raw_ostream.h"
@@ -16,8 +24,11 @@
 #include "llvm/InstVisitor.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 #include <map>
+#include <set>
 
 using namespace cto;
 using namespace std;
@@ -28,12 +39,6 @@ STATISTIC(Float2FixConverted,
 STATISTIC(ValuesReconvertedToFloat,
           "Number of values converted back from fixed to float");
 
-static cl::opt<unsigned> DecimalPrecision("precision-bitwidth", cl::init(16),
-    cl::desc("float2fix: Precision requested for the decimal part in order"
-             "to enable conversion to fixed point. This is expressed as"
-             "the number of \"equivalent\" decimal bits."
-             "For this optionto take effect, the PrecisionAnalyis pass"
-             "should be executed before the float2fix-analysis pass."));
 static cl::opt<unsigned> InternalBitWidth("internal-bitwidth", cl::init(200),
     cl::desc("float2fix: Specify the number of internal bitwidth."
              "In this case all the operations are converted to fixed point"
@@ -43,6 +48,17 @@ static cl::opt<unsigned> InternalBitWidth("internal-bitwidth", cl::init(200),
 namespace {
 
 typedef std::map<Value *, Value *> inst_cache_t;
+// Reciprocals of the divisors, by the block they are computed in
+typedef std::map<std::pair<Value *, BasicBlock *>, Value *> reciprocal_cache_t;
+
+// Where an operand is used: at the end of the incoming block for the phi
+// nodes, which is where the value converted back must be available
+static Instruction *getUsePoint(Instruction *user, unsigned operand) {
+  if (PHINode *PN = dyn_cast<PHINode>(user)) {
+    return PN->getIncomingBlock(operand)->getTerminator();
+  }
+  return user;
+}
 
 static inline bool rangeOk(Range range, uint64_t integerBW) {
   uint64_t limit = 1 << (integerBW - 1);
@@ -65,6 +81,7 @@ struct Float2Fix : public FunctionPass {
     AU.addRequired<PrecisionAnalysis>();
     AU.addRequired<FloatRangeAnalysis>();
     AU.addRequired<DominatorTree>();
+    AU.addRequired<LoopInfo>();
     AU.setPreservesAll();
   }
 private:
@@ -72,32 +89,115 @@ private:
   OptionalValue<uint64_t> Precision;
   FloatRangeAnalysis *FRA;
   PrecisionAnalysis *PRA;
+  // Memory objects replaced by integer buffers
+  std::set<unsigned> ConvertedObjects;
 
   void convertParametersToFloat(
     Instruction *inst,
+    const FixedPointFormats &formats,
     inst_cache_t &converted_values,
-    inst_cache_t &converted_back);
+    inst_cache_t &converted_back,
+    std::vector<Value *> &kept);
 
   void printConverted(const Function &F) const;
 
+  void collectKeptAccesses(const std::vector<Value *> &kept,
+                           const inst_cache_t &converted_values,
+                           std::set<Instruction *> &accesses) const;
+
+  // Instructions the ConverterVisitor knows how to convert (e.g. calls can
+  // have a range, but are never converted)
+  bool isConvertible(const Instruction *inst) const {
+    if (const BinaryOperator *bop = dyn_cast<BinaryOperator>(inst)) {
+      switch (bop->getOpcode()) {
+      case Instruction::FAdd:
+      case Instruction::FSub:
+      case Instruction::FMul:
+      case Instruction::FDiv:
+        return true;
+      default:
+        return false;
+      }
+    }
+    if (isa<PHINode>(inst) || isa<SelectInst>(inst) || isLaneOperation(inst))
+      return inst->getType()->isFPOrFPVectorTy();
+    if (const CastInst *cast = dyn_cast<CastInst>(inst))
+      return isCastSupported(*cast);
+    if (const CallInst *call = dyn_cast<CallInst>(inst))
+      return getMathFunction(*call) != NotMathFunction;
+    // The accesses to a buffer are converted together with it
+    if (isa<LoadInst>(inst) || isa<StoreInst>(inst))
+      return ConvertedObjects.count(FRA->getRanges().Memory.lookup(inst)) > 0;
+    return isa<FCmpInst>(inst);
+  }
+
+  // An object can be replaced by an integer buffer if all the values loaded
+  // and stored fit, since its elements have a single fixed point format,
+  // and if the users of its loads that are not converted can read them
+  // converted back (as the floating point stores are removed)
+  void computeConvertedObjects(bool usePrecisionAnalysis) {
+    const MemoryObjects &Memory = FRA->getRanges().Memory;
+    DominatorTree &DOM = getAnalysis<DominatorTree>();
+    ConvertedObjects.clear();
+    for (unsigned idx = 0; idx < Memory.size(); ++idx) {
+      const MemoryObjects::Object &object = Memory.getObject(idx);
+      bool fits = object.Rewritable;
+      for (std::vector<LoadInst *>::const_iterator it = object.Loads.begin(),
+           end = object.Loads.end(); it != end && fits; ++it) {
+        fits = fitsFixedPoint(*it, usePrecisionAnalysis);
+        for (Value::use_iterator u = (*it)->use_begin(), ue = (*it)->use_end();
+             u != ue && fits; ++u) {
+          Instruction *user = dyn_cast<Instruction>(*u);
+          fits = user != NULL && DOM.dominates(*it, getUsePoint(user, u.getOperandNo()));
+        }
+      }
+      for (std::vector<StoreInst *>::const_iterator it = object.Stores.begin(),
+           end = object.Stores.end(); it != end && fits; ++it) {
+        fits = fitsFixedPoint(*it, usePrecisionAnalysis);
+      }
+      if (fits) {
+        ConvertedObjects.insert(idx);
+      }
+    }
+  }
+
   bool okToConvert(const Function &F, const Instruction *inst, bool usePrecisionAnalysis) const {
+    return isConvertible(inst) && fitsFixedPoint(inst, usePrecisionAnalysis);
+  }
+
+  bool fitsWord(const Value *val) const {
+    OptionalValue<uint64_t> bits = getIntegerBits(FRA->getRange(val));
+    return bits.isValid() && bits.get() < WORD_LENGTH;
+  }
+
+  bool fitsFixedPoint(const Instruction *inst, bool usePrecisionAnalysis) const {
     if (usePrecisionAnalysis) {
-      if (!Precision.isValid() || Precision.get() < DecimalPrecision.getValue())
+      if (!Precision.isValid() || Precision.get() < getRequestedPrecision())
         return false;
 
-      if ((isa<FCmpInst>(inst) && FRA->getRange(inst->getOperand(0)).isValid()
-           && FRA->getRange(inst->getOperand(1)).isValid()))
-        return true;
-
-      return FRA->getRange(inst) != Range::Top;
+      // Each value gets the format of its range, which must fit in the word
+      if (isa<FCmpInst>(inst))
+        return fitsWord(inst->getOperand(0)) && fitsWord(inst->getOperand(1));
+      if (!fitsWord(inst))
+        return false;
+      for (Instruction::const_op_iterator ops = inst->op_begin(),
+           opend = inst->op_end(); ops != opend; ++ops) {
+        if (ops->get()->getType()->isFPOrFPVectorTy() && !fitsWord(ops->get()))
+          return false;
+      }
+      return true;
     } else {
       uint64_t integerBW = WORD_LENGTH - 2 * DecimalBitWidth;
 
       if (isa<FCmpInst>(inst) || !rangeOk(FRA->getRange(inst), integerBW))
         return false;
 
+      // Integers (e.g. the conditions of the selects), and the callees of
+      // the math functions, are not converted
       for (Instruction::const_op_iterator ops = inst->op_begin(),
            opend = inst->op_end(); ops != opend; ++ops) {
+        if (!ops->get()->getType()->isFPOrFPVectorTy())
+          continue;
         if (!rangeOk(FRA->getRange(ops->get()), integerBW))
           return false;
       }
@@ -106,99 +206,237 @@ private:
   }
 };
 
+// Every value is converted to the fixed point format of its own range, in
+// an integer of the width chosen for it (see FixedPointFormat.h): the
+// operands are aligned with shifts where the formats differ, and each
+// operation is computed in an integer wide enough for its operands and
+// result, then brought to the width of the result.
 struct ConverterVisitor : public InstVisitor<ConverterVisitor> {
 
-  ConverterVisitor(uint64_t decimalBitWidth) :
-    decimalBitWidth(decimalBitWidth) {}
+  ConverterVisitor(LLVMContext &context, const FixedPointFormats &formats,
+                   const LoopInfoBase<BasicBlock, Loop> &LI) :
+    formats(formats),
+    LI(LI),
+    builder(context) {}
 
+  // Sums are computed in the format of the operand with the widest range
   void visitFAdd(BinaryOperator &B) {
-    vector<Value *> FixedPointOperands = convertOperands(B);
-    BinaryOperator *converted = BinaryOperator::CreateAdd(
-                                  FixedPointOperands.at(0),
-                                  FixedPointOperands.at(1),
-                                  "fixadd");
-    converted->insertAfter(&B);
-    convertedValues[&B] = converted;
+    setInsertPointAfter(B);
+    int common = getOperandsFormat(B);
+    unsigned width = getOperationWidth(B, common);
+    Value *lhs = convertOperand(B.getOperand(0), common, width);
+    Value *rhs = convertOperand(B.getOperand(1), common, width);
+    Value *sum = builder.CreateAdd(lhs, rhs, "fixadd");
+    convertedValues[&B] = adjust(sum, common, formats.getFormat(&B), formats.getWidth(&B));
   }
 
   void visitFSub(BinaryOperator &B) {
-    vector<Value *> FixedPointOperands = convertOperands(B);
-    BinaryOperator *converted;
-    converted = BinaryOperator::CreateSub(
-                  FixedPointOperands.at(0),
-                  FixedPointOperands.at(1),
-                  "fixsub");
-    converted->insertAfter(&B);
-    convertedValues[&B] = converted;
+    setInsertPointAfter(B);
+    int common = getOperandsFormat(B);
+    unsigned width = getOperationWidth(B, common);
+    Value *lhs = convertOperand(B.getOperand(0), common, width);
+    Value *rhs = convertOperand(B.getOperand(1), common, width);
+    Value *difference = builder.CreateSub(lhs, rhs, "fixsub");
+    convertedValues[&B] = adjust(difference, common, formats.getFormat(&B),
+                                 formats.getWidth(&B));
   }
 
   void visitFMul(BinaryOperator &B) {
-    vector<Value *> FixedPointOperands = convertOperands(B);
-    ConstantInt *ShiftAmount(ConstantInt::get(
-                               IntegerType::get(B.getContext(), WORD_LENGTH),
-                               decimalBitWidth,
-                               true));
-    BinaryOperator *mul = BinaryOperator::CreateMul(
-                            FixedPointOperands.at(0),
-                            FixedPointOperands.at(1),
-                            "fixmul");
-    BinaryOperator *converted = BinaryOperator::CreateAShr(
-                                  mul,
-                                  ShiftAmount,
-                                  "fixashr");
-
-    mul->insertAfter(&B);
-    converted->insertAfter(mul);
-    convertedValues[&B] = converted;
+    setInsertPointAfter(B);
+    convertedValues[&B] = convertProduct(B.getOperand(0), B.getOperand(1),
+                                         formats.getIntegerBits(&B), formats.getFormat(&B),
+                                         formats.getWidth(&B));
   }
 
+  // Where possible, the product by the reciprocal of the divisor (see
+  // ReciprocalLowering), instead of a division
   void visitFDiv(BinaryOperator &B) {
-    vector<Value *> FixedPointOperands = convertOperands(B);
-    ConstantInt *ShiftAmount(ConstantInt::get(
-                               IntegerType::get(B.getContext(), WORD_LENGTH),
-                               decimalBitWidth,
-                               true));
-    BinaryOperator *sft = BinaryOperator::CreateShl(
-                            FixedPointOperands.at(0),
-                            ShiftAmount,
-                            "sft");
-    BinaryOperator *converted = BinaryOperator::CreateSDiv(
-                                  sft,
-                                  FixedPointOperands.at(1),
-                                  "fixdiv");
-    sft->insertAfter(&B);
-    converted->insertAfter(sft);
-    convertedValues[&B] = converted;
+    ReciprocalLowering reciprocal;
+    if (formats.getReciprocalLowering(B, LI, reciprocal)) {
+      Value *inverse = getReciprocal(B.getOperand(1), reciprocal);
+      setInsertPointAfter(B);
+      convertedValues[&B] = convertReciprocalProduct(B, inverse, reciprocal);
+      return;
+    }
+    setInsertPointAfter(B);
+    Value *op1 = B.getOperand(0);
+    Value *op2 = B.getOperand(1);
+    int f1 = formats.getFormat(op1);
+    int f2 = formats.getFormat(op2);
+    int format = formats.getFormat(&B);
+    QuotientLowering lowering(f1, f2, format, formats.getIntegerBits(op1));
+    unsigned width = std::max(getWidthAt(op1, f1 + lowering.Shift),
+                              std::max(getWidthAt(op2, f2),
+                                       getWidthAt(&B, lowering.Fraction)));
+    Value *dividend = convertOperand(op1, f1 + lowering.Shift, width);
+    Value *divisor = convertOperand(op2, f2, width);
+    Value *quotient = builder.CreateSDiv(dividend, divisor, "fixdiv");
+    convertedValues[&B] = adjust(quotient, lowering.Fraction, format, formats.getWidth(&B));
   }
 
+  // The incoming values are aligned at the end of their blocks
   void visitPHI(PHINode &P) {
-    vector<Value *> values = convertOperands(P);
+    int format = formats.getFormat(&P);
+    unsigned width = formats.getWidth(&P);
     PHINode *converted = PHINode::Create(
-                           values.at(0)->getType(),
-                           values.size(),
+                           getFixedPointType(P.getType(), width),
+                           P.getNumIncomingValues(),
                            "fixphi");
+    converted->insertAfter(&P);
     for (unsigned i = 0; i < P.getNumIncomingValues(); ++i) {
-      converted->addIncoming(values.at(i), P.getIncomingBlock(i));
+      BasicBlock *incoming = P.getIncomingBlock(i);
+      builder.SetInsertPoint(incoming->getTerminator());
+      converted->addIncoming(convertOperand(P.getIncomingValue(i), format, width), incoming);
     }
-    converted->insertAfter(&P);
     convertedValues[&P] = converted;
   }
 
   void visitFCmp(FCmpInst &B) {
-    vector<Value *> FixedPointOperands = convertOperands(B);
+    setInsertPointAfter(B);
+    int common = getOperandsFormat(B);
+    unsigned width = std::max(getWidthAt(B.getOperand(0), common),
+                              getWidthAt(B.getOperand(1), common));
+    Value *lhs = convertOperand(B.getOperand(0), common, width);
+    Value *rhs = convertOperand(B.getOperand(1), common, width);
     CmpInst::Predicate pred = B.getPredicate();
     if (CmpInst::isFPPredicate(pred)) {
       pred = convertPredicate(pred);
     }
+    // Not folded, as the converted comparisons are told apart by their class
     CmpInst *converted = CmpInst::Create(CmpInst::ICmp,
                                          pred,
-                                         FixedPointOperands.at(0),
-                                         FixedPointOperands.at(1),
+                                         lhs,
+                                         rhs,
                                          "conv-icmp");
-    converted->insertAfter(&B);
+    builder.Insert(converted);
     convertedValues[&B] = converted;
   }
 
+  // The casts between floating point types do not change the fixed point
+  // representation, but the result may have another format
+  void visitFPExtInst(FPExtInst &I) {
+    setInsertPointAfter(I);
+    convertedValues[&I] = convertOperand(I.getOperand(0), formats.getFormat(&I),
+                                         formats.getWidth(&I));
+  }
+
+  void visitFPTruncInst(FPTruncInst &I) {
+    setInsertPointAfter(I);
+    convertedValues[&I] = convertOperand(I.getOperand(0), formats.getFormat(&I),
+                                         formats.getWidth(&I));
+  }
+
+  void visitSIToFPInst(SIToFPInst &I) {
+    convertInteger(I, true);
+  }
+
+  void visitUIToFPInst(UIToFPInst &I) {
+    convertInteger(I, false);
+  }
+
+  // The condition is replaced by the converted comparison, if any
+  void visitSelectInst(SelectInst &S) {
+    setInsertPointAfter(S);
+    Value *condition = S.getCondition();
+    inst_cache_t::iterator cached = convertedValues.find(condition);
+    if (cached != convertedValues.end()) {
+      condition = cached->second;
+    }
+    int format = formats.getFormat(&S);
+    unsigned width = formats.getWidth(&S);
+    Value *trueValue = convertOperand(S.getTrueValue(), format, width);
+    Value *falseValue = convertOperand(S.getFalseValue(), format, width);
+    convertedValues[&S] = builder.CreateSelect(condition, trueValue, falseValue, "fixselect");
+  }
+
+  // The lanes are moved in the format and width of the result (the lane
+  // extracted, in the ones of the vector)
+  void visitExtractElementInst(ExtractElementInst &E) {
+    setInsertPointAfter(E);
+    Value *vector = E.getVectorOperand();
+    Value *lane = builder.CreateExtractElement(convertOperand(vector), E.getIndexOperand(),
+                                               "fixextract");
+    convertedValues[&E] = adjust(lane, formats.getFormat(vector), formats.getFormat(&E),
+                                 formats.getWidth(&E));
+  }
+
+  void visitInsertElementInst(InsertElementInst &I) {
+    setInsertPointAfter(I);
+    int format = formats.getFormat(&I);
+    unsigned width = formats.getWidth(&I);
+    Value *vector = convertOperand(I.getOperand(0), format, width);
+    Value *lane = convertOperand(I.getOperand(1), format, width);
+    convertedValues[&I] = builder.CreateInsertElement(vector, lane, I.getOperand(2),
+                                                      "fixinsert");
+  }
+
+  void visitShuffleVectorInst(ShuffleVectorInst &S) {
+    setInsertPointAfter(S);
+    int format = formats.getFormat(&S);
+    unsigned width = formats.getWidth(&S);
+    Value *v1 = convertOperand(S.getOperand(0), format, width);
+    Value *v2 = convertOperand(S.getOperand(1), format, width);
+    convertedValues[&S] = builder.CreateShuffleVector(v1, v2, S.getMask(), "fixshuffle");
+  }
+
+  void visitCallInst(CallInst &C) {
+    switch (getMathFunction(C)) {
+    case Fabs:
+      convertFabs(C);
+      break;
+    case Sqrt:
+      convertSqrt(C);
+      break;
+    case FMulAdd:
+      convertFMulAdd(C);
+      break;
+    case FMin:
+      convertMinMax(C, CmpInst::ICMP_SLT);
+      break;
+    case FMax:
+      convertMinMax(C, CmpInst::ICMP_SGT);
+      break;
+    default:
+      visitInstruction(C);
+      break;
+    }
+  }
+
+  // The accesses to a converted buffer are redirected to its integer
+  // version, created along with it, whose elements share a single format
+  void visitLoadInst(LoadInst &L) {
+    setInsertPointAfter(L);
+    Value *ptr = convertPointer(L.getPointerOperand(), formats.getAccessWidth(&L));
+    Value *loaded = builder.CreateLoad(ptr, "fixload");
+    convertedValues[&L] = adjust(loaded, formats.getAccessFormat(&L), formats.getFormat(&L),
+                                 formats.getWidth(&L));
+  }
+
+  void visitStoreInst(StoreInst &S) {
+    setInsertPointAfter(S);
+    unsigned width = formats.getAccessWidth(&S);
+    Value *stored = convertOperand(S.getValueOperand(), formats.getAccessFormat(&S), width);
+    builder.CreateStore(stored, convertPointer(S.getPointerOperand(), width));
+    replaced.push_back(&S);
+  }
+
+  // A zeroing memset of a converted buffer: zero is zero in fixed point too,
+  // but the integer elements may be larger than the floating point ones
+  void convertClear(MemSetInst &MS, unsigned object) {
+    unsigned width = formats.getObjectWidth(object);
+    Value *dest = cast<User>(MS.getRawDest())->getOperand(0);
+    Type *elementType = cast<PointerType>(dest->getType())->getElementType();
+    while (ArrayType *AT = dyn_cast<ArrayType>(elementType)) {
+      elementType = AT->getElementType();
+    }
+    uint64_t elementBytes = elementType->getPrimitiveSizeInBits() / 8;
+    uint64_t length = cast<ConstantInt>(MS.getLength())->getZExtValue();
+    IRBuilder<> builder(&MS);
+    builder.CreateMemSet(convertPointer(dest, width), builder.getInt8(0),
+                         length / elementBytes * (width / 8), MS.getAlignment());
+    replaced.push_back(&MS);
+  }
+
   void visitInstruction(Instruction &I) {
     report_fatal_error("Attempting to convert an unsupported operation!");
   }
@@ -207,9 +445,291 @@ struct ConverterVisitor : public InstVisitor<ConverterVisitor> {
     return convertedValues;
   }
 
+  // Stores and memsets of the floating point buffers, which are not needed
+  // any more once the conversion is complete
+  const std::vector<Instruction *> &getReplacedInstructions() const {
+    return replaced;
+  }
+
 private:
-  uint64_t decimalBitWidth;
+  const FixedPointFormats &formats;
+  const LoopInfoBase<BasicBlock, Loop> &LI;
+  // Inserts the conversions of the instruction being visited
+  IRBuilder<> builder;
   inst_cache_t convertedValues;
+  reciprocal_cache_t reciprocals;
+  // Kept apart from the values, as the pointers are never converted back
+  inst_cache_t convertedPointers;
+  std::vector<Instruction *> replaced;
+
+  // Right after the instruction, or after the phi nodes of its block
+  void setInsertPointAfter(Instruction &I) {
+    if (isa<PHINode>(&I)) {
+      builder.SetInsertPoint(I.getParent(), I.getParent()->getFirstInsertionPt());
+    } else {
+      BasicBlock::iterator next = &I;
+      builder.SetInsertPoint(I.getParent(), ++next);
+    }
+  }
+
+  // Format the first two operands are aligned to
+  int getOperandsFormat(Instruction &I) const {
+    return getCommonFormat(formats.getFormat(I.getOperand(0)),
+                           formats.getFormat(I.getOperand(1)));
+  }
+
+  // Width of the integer holding val in the given format
+  unsigned getWidthAt(const Value *val, int format) const {
+    OptionalValue<uint64_t> integerBits = formats.getIntegerBits(val);
+    if (!integerBits.isValid()) {
+      return WORD_LENGTH;
+    }
+    return getContainingWidth(static_cast<int>(integerBits.get()) + format);
+  }
+
+  // Width the binary operation is computed in, with the operands aligned to
+  // the given format
+  unsigned getOperationWidth(Instruction &I, int format) const {
+    return std::max(getWidthAt(&I, format),
+                    std::max(getWidthAt(I.getOperand(0), format),
+                             getWidthAt(I.getOperand(1), format)));
+  }
+
+  // Move a fixed point value from a format to another (constants are folded)
+  Value *align(Value *fixed, int from, int to) {
+    if (from < to) {
+      return builder.CreateShl(fixed, to - from, "fixshl");
+    }
+    if (from > to) {
+      return builder.CreateAShr(fixed, from - to, "fixashr");
+    }
+    return fixed;
+  }
+
+  // Move a fixed point value to another format and width: it is extended
+  // before a left shift, and truncated after a right one, as the value
+  // fits both widths in the format it has there
+  Value *adjust(Value *fixed, int from, int to, unsigned width) {
+    unsigned current = fixed->getType()->getScalarSizeInBits();
+    if (current < width) {
+      fixed = builder.CreateSExt(fixed, getFixedPointType(fixed->getType(), width), "fixsext");
+    }
+    fixed = align(fixed, from, to);
+    if (current > width) {
+      fixed = builder.CreateTrunc(fixed, getFixedPointType(fixed->getType(), width), "fixtrunc");
+    }
+    return fixed;
+  }
+
+  // Product of the operands, whose integer part takes integerBits, in the
+  // given format and width: it is computed in an integer holding the
+  // operands and the product, which is wider than them only if needed (up
+  // to a double word, whose high part is kept, as a single widening
+  // multiplication)
+  Value *convertProduct(Value *op1, Value *op2, OptionalValue<uint64_t> integerBits,
+                        int format, unsigned width) {
+    int f1 = formats.getFormat(op1);
+    int f2 = formats.getFormat(op2);
+    ProductLowering lowering(f1, f2, integerBits);
+    int bits = integerBits.isValid() ? static_cast<int>(integerBits.get()) : WORD_LENGTH;
+    unsigned productWidth = std::max(getContainingWidth(bits + lowering.Fraction),
+                                     std::max(getWidthAt(op1, f1 - lowering.Shift1),
+                                              getWidthAt(op2, f2 - lowering.Shift2)));
+    Value *lhs = convertOperand(op1, f1 - lowering.Shift1, productWidth);
+    Value *rhs = convertOperand(op2, f2 - lowering.Shift2, productWidth);
+    Value *product = builder.CreateMul(lhs, rhs, "fixmul");
+    return adjust(product, lowering.Fraction, format, width);
+  }
+
+  // Quotient of the division, as the product of the dividend by the
+  // reciprocal of the divisor, in a word
+  Value *convertReciprocalProduct(BinaryOperator &B, Value *inverse,
+                                  const ReciprocalLowering &reciprocal) {
+    Value *op1 = B.getOperand(0);
+    int f1 = formats.getFormat(op1);
+    OptionalValue<uint64_t> integerBits = formats.getIntegerBits(&B);
+    ProductLowering lowering(f1, reciprocal.Fraction, integerBits);
+    int bits = integerBits.isValid() ? static_cast<int>(integerBits.get()) : WORD_LENGTH;
+    int inverseFormat = reciprocal.Fraction - lowering.Shift2;
+    int inverseBits = static_cast<int>(reciprocal.IntegerBits.get()) + inverseFormat;
+    unsigned productWidth = std::max(getContainingWidth(bits + lowering.Fraction),
+                                     std::max(getWidthAt(op1, f1 - lowering.Shift1),
+                                              getContainingWidth(inverseBits)));
+    Value *lhs = convertOperand(op1, f1 - lowering.Shift1, productWidth);
+    Value *rhs = adjust(inverse, reciprocal.Fraction, inverseFormat, productWidth);
+    Value *product = builder.CreateMul(lhs, rhs, "fixmul");
+    return adjust(product, lowering.Fraction, formats.getFormat(&B), formats.getWidth(&B));
+  }
+
+  // Reciprocal of the divisor, in a word: folded for the constants, and
+  // otherwise computed once at the end of the preheader, as the quotient of
+  // 2^(format + f) by the divisor in a double word
+  Value *getReciprocal(Value *divisor, const ReciprocalLowering &reciprocal) {
+    Type *type = getFixedPointType(divisor->getType(), WORD_LENGTH);
+    if (Constant *C = dyn_cast<Constant>(divisor)) {
+      return getReciprocalConstant(C, reciprocal.Fraction, type);
+    }
+    std::pair<Value *, BasicBlock *> key(divisor, reciprocal.Preheader);
+    reciprocal_cache_t::iterator cached = reciprocals.find(key);
+    if (cached != reciprocals.end()) {
+      return cached->second;
+    }
+    builder.SetInsertPoint(reciprocal.Preheader->getTerminator());
+    int format = formats.getFormat(divisor);
+    unsigned width = 2 * WORD_LENGTH;
+    Constant *one = ConstantInt::get(getFixedPointType(divisor->getType(), width),
+                                     APInt::getOneBitSet(width, reciprocal.Fraction + format));
+    Value *quotient = builder.CreateSDiv(one, convertOperand(divisor, format, width),
+                                         "fixrecipdiv");
+    Value *inverse = builder.CreateTrunc(quotient, type, "fixrecip");
+    reciprocals[key] = inverse;
+    return inverse;
+  }
+
+  // 2^format / d, truncated as the conversions of the constants: with
+  // |d| = m 2^e and m an integer, it is computed exactly as 2^(format - e) / m
+  static Constant *getReciprocalConstant(Constant *C, int format, Type *type) {
+    if (VectorType *VT = dyn_cast<VectorType>(C->getType())) {
+      std::vector<Constant *> lanes;
+      for (unsigned i = 0; i < VT->getNumElements(); ++i) {
+        Constant *lane = C->getAggregateElement(i);
+        lanes.push_back(isa<ConstantFP>(lane)
+                        ? getReciprocalConstant(lane, format, type->getScalarType())
+                        : UndefValue::get(type->getScalarType()));
+      }
+      return ConstantVector::get(lanes);
+    }
+    APFloat value = cast<ConstantFP>(C)->getValueAPF();
+    bool losesInfo;
+    value.convert(APFloat::IEEEdouble, APFloat::rmNearestTiesToEven, &losesInfo);
+    double d = value.convertToDouble();
+    int exponent;
+    double mantissa = ::frexp(::fabs(d), &exponent);
+    unsigned width = 3 * WORD_LENGTH;
+    APInt m(width, static_cast<uint64_t>(::ldexp(mantissa, DBL_MANT_DIG)));
+    int shift = format + DBL_MANT_DIG - exponent;
+    APInt inverse = shift < 0 ? APInt(width, 0) : APInt::getOneBitSet(width, shift).udiv(m);
+    inverse = inverse.trunc(WORD_LENGTH);
+    return ConstantInt::get(type, d < 0 ? -inverse : inverse);
+  }
+
+  // The fixed point version of a floating point type (a scalar, a vector,
+  // or the arrays of a buffer) has the same shape, with the elements
+  // replaced by integers of the given width
+  static Type *getFixedPointType(Type *type, unsigned width) {
+    if (ArrayType *AT = dyn_cast<ArrayType>(type)) {
+      return ArrayType::get(getFixedPointType(AT->getElementType(), width),
+                            AT->getNumElements());
+    }
+    if (VectorType *VT = dyn_cast<VectorType>(type)) {
+      return VectorType::get(IntegerType::get(type->getContext(), width),
+                             VT->getNumElements());
+    }
+    return IntegerType::get(type->getContext(), width);
+  }
+
+  // Pointer to the integer version of the element, or of the buffer: the
+  // getelementptrs are repeated on it
+  Value *convertPointer(Value *ptr, unsigned width) {
+    inst_cache_t::iterator cached = convertedPointers.find(ptr);
+    if (cached != convertedPointers.end()) {
+      return cached->second;
+    }
+    Instruction *converted;
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(ptr)) {
+      // As aligned as the floating point one, as the memsets expect
+      AllocaInst *buffer = new AllocaInst(getFixedPointType(AI->getAllocatedType(), width),
+                                          AI->getArraySize(), "fixbuf");
+      buffer->setAlignment(AI->getAlignment());
+      converted = buffer;
+    } else {
+      GetElementPtrInst *GEP = cast<GetElementPtrInst>(ptr);
+      std::vector<Value *> indices(GEP->idx_begin(), GEP->idx_end());
+      GetElementPtrInst *fixedGEP = GetElementPtrInst::Create(
+                                      convertPointer(GEP->getPointerOperand(), width),
+                                      indices,
+                                      "fixgep");
+      fixedGEP->setIsInBounds(GEP->isInBounds());
+      converted = fixedGEP;
+    }
+    converted->insertAfter(cast<Instruction>(ptr));
+    convertedPointers[ptr] = converted;
+    return converted;
+  }
+
+  // Integers are extended (or truncated, as they fit the range) to the
+  // width of the result, and shifted to the units
+  void convertInteger(CastInst &I, bool isSigned) {
+    setInsertPointAfter(I);
+    Value *operand = builder.CreateIntCast(I.getOperand(0),
+                                           getFixedPointType(I.getType(), formats.getWidth(&I)),
+                                           isSigned, "fixext");
+    convertedValues[&I] = builder.CreateShl(operand, formats.getFormat(&I), "fixitofp");
+  }
+
+  void convertFabs(CallInst &C) {
+    setInsertPointAfter(C);
+    Value *op = C.getArgOperand(0);
+    Value *operand = convertOperand(op);
+    Value *negative = builder.CreateICmpSLT(operand, ConstantInt::get(operand->getType(), 0),
+                                            "fixisneg");
+    Value *neg = builder.CreateNeg(operand, "fixneg");
+    Value *abs = builder.CreateSelect(negative, neg, operand, "fixabs");
+    convertedValues[&C] = adjust(abs, formats.getFormat(op), formats.getFormat(&C),
+                                 formats.getWidth(&C));
+  }
+
+  // There is no integer square root: with x = X / 2^f, the result in the
+  // format r is sqrt(x) 2^r = sqrt(X 2^(2r - f)), computed in double precision
+  void convertSqrt(CallInst &C) {
+    setInsertPointAfter(C);
+    Value *op = C.getArgOperand(0);
+    Type *DoubleType = Type::getDoubleTy(C.getContext());
+    Module *M = C.getParent()->getParent()->getParent();
+    int scale = 2 * formats.getFormat(&C) - formats.getFormat(op);
+    Value *cast = builder.CreateSIToFP(convertOperand(op), DoubleType, "fixsqrt-cast");
+    Value *scaled = builder.CreateFMul(cast, ConstantFP::get(DoubleType, ::ldexp(1.0, scale)),
+                                       "fixsqrt-fmul");
+    Value *root = builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::sqrt, DoubleType),
+                                     scaled, "fixsqrt-root");
+    convertedValues[&C] = builder.CreateFPToSI(root,
+                                               getFixedPointType(C.getType(),
+                                                                 formats.getWidth(&C)),
+                                               "fixsqrt");
+  }
+
+  // The product gets the format of its own range, and is then added
+  void convertFMulAdd(CallInst &C) {
+    setInsertPointAfter(C);
+    Value *op1 = C.getArgOperand(0);
+    Value *op2 = C.getArgOperand(1);
+    Value *op3 = C.getArgOperand(2);
+    OptionalValue<uint64_t> productBits = formats.getProductBits(op1, op2);
+    int product = formats.getProductFormat(op1, op2);
+    int common = getCommonFormat(product, formats.getFormat(op3));
+    Value *mul = convertProduct(op1, op2, productBits, product,
+                                formats.getProductWidth(op1, op2));
+    int bits = productBits.isValid() ? static_cast<int>(productBits.get()) : WORD_LENGTH;
+    unsigned width = std::max(getContainingWidth(bits + common),
+                              std::max(getWidthAt(op3, common), getWidthAt(&C, common)));
+    Value *sum = builder.CreateAdd(adjust(mul, product, common, width),
+                                   convertOperand(op3, common, width), "fixadd");
+    convertedValues[&C] = adjust(sum, common, formats.getFormat(&C), formats.getWidth(&C));
+  }
+
+  // fmin and fmax, as the select of the operand satisfying pred
+  void convertMinMax(CallInst &C, CmpInst::Predicate pred) {
+    setInsertPointAfter(C);
+    int common = getOperandsFormat(C);
+    unsigned width = std::max(getWidthAt(C.getArgOperand(0), common),
+                              getWidthAt(C.getArgOperand(1), common));
+    Value *lhs = convertOperand(C.getArgOperand(0), common, width);
+    Value *rhs = convertOperand(C.getArgOperand(1), common, width);
+    Value *cmp = builder.CreateICmp(pred, lhs, rhs, "fixcmp");
+    Value *selected = builder.CreateSelect(cmp, lhs, rhs,
+                                           pred == CmpInst::ICMP_SLT ? "fixmin" : "fixmax");
+    convertedValues[&C] = adjust(selected, common, formats.getFormat(&C), formats.getWidth(&C));
+  }
 
   CmpInst::Predicate convertPredicate(CmpInst::Predicate pred) {
     if (CmpInst::isIntPredicate(pred)) {
@@ -260,18 +780,21 @@ private:
       return floatToFixedConstant(dyn_cast<llvm::Constant>(operand));
     }
 
-    assert(operand->getType()->isFloatTy() || operand->getType()->isDoubleTy());
+    Type *scalarType = operand->getType()->getScalarType();
+    assert(scalarType->isFloatTy() || scalarType->isDoubleTy());
 
-    ConstantFP *factor_cfp = ConstantFP::get(
-                               operand->getContext(),
-                               APFloat(static_cast<double>((1 << decimalBitWidth))));
+    // The factor has the type of the operand, which may be a float (or a
+    // vector, which gets the factor in each lane)
+    Constant *factor_cfp = ConstantFP::get(
+                             operand->getType(),
+                             ::ldexp(1.0, formats.getFormat(operand)));
     Instruction *double_mul = BinaryOperator::CreateFMul(
                                 operand,
                                 factor_cfp,
                                 "conv-fmul");
     Instruction *cast = new FPToSIInst(
       double_mul,
-      IntegerType::get(operand->getContext(), 64), "conv-cast");
+      getFixedPointType(operand->getType(), formats.getWidth(operand)), "conv-cast");
 
     if (Instruction *insertionPoint = dyn_cast<Instruction>(operand)) {
       double_mul->insertAfter(insertionPoint);
@@ -287,57 +810,64 @@ private:
     return cast;
   }
 
-  std::vector<Value *> convertOperands(Instruction &I) {
-    std::vector<Value *> FixedPointOperands;
-    for (User::op_iterator ops = I.op_begin(), opend = I.op_end();
-         ops != opend; ++ops) {
-      inst_cache_t::iterator cached = convertedValues.find(ops->get());
-      if (cached == convertedValues.end()) { // cache miss
-        Value *converted = floatToFixed(ops->get());
-        convertedValues[ops->get()] = converted;
-        FixedPointOperands.push_back(converted);
-      } else {                               // cache hit
-        FixedPointOperands.push_back(cached->second);
-      }
-    }
-    return FixedPointOperands;
+  Value *convertOperand(Value *operand) {
+    inst_cache_t::iterator cached = convertedValues.find(operand);
+    if (cached == convertedValues.end()) { // cache miss
+      Value *converted = floatToFixed(operand);
+      convertedValues[operand] = converted;
+      return converted;
+    }                                      // cache hit
+    return cached->second;
+  }
+
+  // The operand in the given format and width
+  Value *convertOperand(Value *operand, int format, unsigned width) {
+    return adjust(convertOperand(operand), formats.getFormat(operand), format, width);
   }
 
   Value *floatToFixedConstant(Constant *operand) {
+    Type *type = getFixedPointType(operand->getType(), formats.getWidth(operand));
+    if (operand->getType()->isVectorTy()) {
+      // Folded lane by lane, as the scalars below (the undefined lanes stay so)
+      Constant *factor = ConstantFP::get(operand->getType(),
+                                         ::ldexp(1.0, formats.getFormat(operand)));
+      return ConstantExpr::getFPToSI(ConstantExpr::getFMul(operand, factor), type);
+    }
     ConstantFP *operand_fp = dyn_cast<ConstantFP>(operand);
     assert(operand_fp != NULL);
     const APFloat &value = operand_fp->getValueAPF();
     double d = value.convertToDouble();
-    return ConstantInt::get(
-             IntegerType::get(operand->getContext(), 64),
-             d * (1 << decimalBitWidth), true);
+    return ConstantInt::get(type, static_cast<int64_t>(::ldexp(d, formats.getFormat(operand))),
+                            true);
   }
 
 };
 
 }
 
-static Value *fixedToFloatConstant(Constant *operand, uint64_t DecimalBitWidth) {
+// The values are converted back to their original type, float or double
+static Value *fixedToFloatConstant(Constant *operand, Type *type, int format) {
+  if (type->isVectorTy()) {
+    return ConstantExpr::getFMul(ConstantExpr::getSIToFP(operand, type),
+                                 ConstantFP::get(type, ::ldexp(1.0, -format)));
+  }
   ConstantInt *operand_fixpoint = dyn_cast<ConstantInt>(operand);
   assert(operand_fixpoint != NULL);
   int64_t value = operand_fixpoint->getSExtValue();
-  double d = (double) value / (1 << DecimalBitWidth);
-  return ConstantFP::get(Type::getDoubleTy(operand->getContext()), d);
+  double d = ::ldexp(static_cast<double>(value), -format);
+  return ConstantFP::get(type, d);
 }
 
-static Value *fixedToFloat(Value *operand, uint64_t DecimalBitWidth) {
+static Value *fixedToFloat(Value *operand, Type *type, int format) {
   if (isa<llvm::Constant>(operand)) { //XXX is this useful?
     return fixedToFloatConstant(
              dyn_cast<llvm::Constant>(operand),
-             DecimalBitWidth);
+             type,
+             format);
   }
   assert(operand->getType()->isIntegerTy());
-  Instruction *cast = new SIToFPInst(
-    operand,
-    Type::getDoubleTy(operand->getContext()), "convfp-cast");
-  ConstantFP *factor_cfp = ConstantFP::get(
-                             operand->getContext(),
-                             APFloat(static_cast<double>((1 << DecimalBitWidth))));
+  Instruction *cast = new SIToFPInst(operand, type, "convfp-cast");
+  Constant *factor_cfp = ConstantFP::get(type, ::ldexp(1.0, format));
   Instruction *div = BinaryOperator::CreateFDiv(
                        cast,
                        factor_cfp,
@@ -371,22 +901,30 @@ bool Float2Fix::runOnFunction(Function &F) {
   FRA = &getAnalysis<FloatRangeAnalysis>();
   Precision = PRA->getEquivalentBitwidth(F);
 
+  // Each value gets the format of its range, unless a uniform one is forced
+  FixedPointFormats Formats(FRA->getRanges());
   bool usePrecisionAnalysis = true;
-  DecimalBitWidth = PRA->getInternalDBW(F);
   if (InternalBitWidth.getValue() <=  WORD_LENGTH) {
     DecimalBitWidth = InternalBitWidth.getValue();
+    Formats.setUniform(DecimalBitWidth);
     usePrecisionAnalysis = false;
   }
 
+  computeConvertedObjects(usePrecisionAnalysis);
+
   DEBUG(printConverted(F));
 
   //1. Generate FixedPoint versions of the values that according to the
-  //   range analysis can be converted with a negligible loss of precision
-  ConverterVisitor visitor(DecimalBitWidth);
-  for (inst_iterator Itr = inst_begin(F), IEnd = inst_end(F);
-       Itr != IEnd; ++Itr) {
-    Instruction *Inst = &(*Itr);
-    if (okToConvert(F, Inst, usePrecisionAnalysis)) {
+  //   range analysis can be converted with a negligible loss of precision.
+  //   Only the instructions in the FP slice can be converted, and they are
+  //   visited in reverse post-order.
+  ConverterVisitor visitor(F.getContext(), Formats, getAnalysis<LoopInfo>().getBase());
+  const ValueNumbering &Numbering = FRA->getNumbering();
+  const std::vector<unsigned> &Slice = FRA->getFPSlice();
+  for (std::vector<unsigned>::const_iterator idx = Slice.begin(), end = Slice.end();
+       idx != end; ++idx) {
+    Instruction *Inst = dyn_cast<Instruction>(Numbering.getValue(*idx));
+    if (Inst != NULL && okToConvert(F, Inst, usePrecisionAnalysis)) {
       // Convert the instruction inst and its parameters to fixed point.
       // converted_values: cache of previously converted parameters:
       //                   if a parameter was previously converted, we use that version
@@ -399,29 +937,96 @@ bool Float2Fix::runOnFunction(Function &F) {
       ++Float2FixConverted;
     }
   }
+  const MemoryObjects &Memory = FRA->getRanges().Memory;
+  for (std::set<unsigned>::iterator it = ConvertedObjects.begin(), end = ConvertedObjects.end();
+       it != end; ++it) {
+    const std::vector<MemSetInst *> &Clears = Memory.getObject(*it).Clears;
+    for (unsigned i = 0; i < Clears.size(); ++i) {
+      visitor.convertClear(*Clears[i], *it);
+    }
+  }
   inst_cache_t ConvertedValues = visitor.getConvertedValues();
 
-  //2. Now scan the code again for the instruction that have not been
-  //   converted, and generate a floating point version of the parameters
+  //2. Now look at the users of the converted values that have not been
+  //   converted, and generate a floating point version of their parameters
   //   that are now converted to fixed point.
+  SmallPtrSet<Instruction *, 32> Seen;
+  std::vector<Instruction *> Users;
+  for (inst_cache_t::iterator it = ConvertedValues.begin(), end = ConvertedValues.end();
+       it != end; ++it) {
+    // Only the instructions are converted back (see convertParametersToFloat)
+    if (!isa<Instruction>(it->first))
+      continue;
+    for (Value::use_iterator u = it->first->use_begin(), ue = it->first->use_end();
+         u != ue; ++u) {
+      Instruction *UserInst = dyn_cast<Instruction>(*u);
+      if (UserInst != NULL && Seen.insert(UserInst)) {
+        Users.push_back(UserInst);
+      }
+    }
+  }
   inst_cache_t ConvertedBackToFloatValues;
-  for (inst_iterator Itr = inst_begin(F), IEnd = inst_end(F);
-       Itr != IEnd; ++Itr) {
-    Instruction *Inst = &(*Itr);
+  std::vector<Value *> Kept;
+  for (std::vector<Instruction *>::iterator it = Users.begin(), end = Users.end();
+       it != end; ++it) {
+    Instruction *Inst = *it;
     if (!okToConvert(F, Inst, usePrecisionAnalysis)) {
       // ensure it has not been converted
       if (ConvertedValues.find(Inst) == ConvertedValues.end())
-        convertParametersToFloat(Inst, ConvertedValues, ConvertedBackToFloatValues);
+        convertParametersToFloat(Inst, Formats, ConvertedValues, ConvertedBackToFloatValues,
+                                 Kept);
+    }
+  }
+
+  //3. The floating point buffers are only read by the floating point
+  //   versions of the converted instructions, which are not used anymore,
+  //   unless some of them were kept: the buffers they read keep their
+  //   floating point stores
+  std::set<Instruction *> KeptAccesses;
+  collectKeptAccesses(Kept, ConvertedValues, KeptAccesses);
+  const std::vector<Instruction *> &Replaced = visitor.getReplacedInstructions();
+  for (std::vector<Instruction *>::const_iterator it = Replaced.begin(), end = Replaced.end();
+       it != end; ++it) {
+    if (KeptAccesses.count(*it) == 0) {
+      (*it)->eraseFromParent();
     }
   }
 
   return IRChanged;
 }
 
-// Convert the parameters of inst, previously converted to fixed point, to float again
+// The stores and memsets of the objects whose floating point loads are still
+// used by the kept values, through the converted instructions computing them
+void Float2Fix::collectKeptAccesses(const std::vector<Value *> &kept,
+                                    const inst_cache_t &converted_values,
+                                    std::set<Instruction *> &accesses) const {
+  const MemoryObjects &Memory = FRA->getRanges().Memory;
+  std::vector<Value *> pending(kept);
+  SmallPtrSet<Value *, 32> visited;
+  while (!pending.empty()) {
+    Value *val = pending.back();
+    pending.pop_back();
+    Instruction *I = dyn_cast<Instruction>(val);
+    if (I == NULL || converted_values.count(I) == 0 || !visited.insert(I))
+      continue;
+    unsigned object = Memory.lookup(I);
+    if (isa<LoadInst>(I) && object != MemoryObjects::NotTracked) {
+      const MemoryObjects::Object &obj = Memory.getObject(object);
+      accesses.insert(obj.Stores.begin(), obj.Stores.end());
+      accesses.insert(obj.Clears.begin(), obj.Clears.end());
+    }
+    pending.insert(pending.end(), I->op_begin(), I->op_end());
+  }
+}
+
+// Convert the parameters of inst, previously converted to fixed point, to
+// float again. The operands that can not be converted back are left to
+// their floating point version, and added to kept.
 void Float2Fix::convertParametersToFloat(Instruction *inst,
+    const FixedPointFormats &formats,
     inst_cache_t &converted_values,
-    inst_cache_t &converted_back) {
+    inst_cache_t &converted_back,
+    std::vector<Value *> &kept) {
 
   DominatorTree &DOM = getAnalysis<DominatorTree>();
 
@@ -442,14 +1047,18 @@ void Float2Fix::convertParametersToFloat(Instruction *inst,
           // Sanity check, although the condition should be always true
           // because the fixed point conversion generates an use right
           // after the floating point definition.
-          if (DOM.dominates(dyn_cast<Instruction>(fixedPoint), inst)) {
+          // (constants come from the casts of constant operands)
+          if (isa<Constant>(fixedPoint)
+              || DOM.dominates(dyn_cast<Instruction>(fixedPoint), getUsePoint(inst, i))) {
             Value *converted;
-            converted = fixedToFloat(fixedPoint, DecimalBitWidth);
+            converted = fixedToFloat(fixedPoint, operand->getType(),
+                                     formats.getFormat(operand));
             converted_back[operand] = converted;
             inst->setOperand(i, converted);
           } else {
             errs() << "Parameter not converted due to domination issues."
                    "Keeping the original floating point version. \n";
+            kept.push_back(operand);
           }
         }
       }
@@ -3,8 +3,19 @@
 #include "FloatRangeAnalysis.h"
 
 #include "OptionalValue.h"
-#include "AnalysisAlgorithm.h"
+#include "AffineForm.h"
+#include "AnalysisAlgorithmImpl.h"
+#include "FixedPointFormat.h"
+#include "InterproceduralRangeAnalysis.h"
+#include "IntervalSet.h"
+#include "ParallelAnalysisDriver.h"
+#include "RangeBatch.h"
+#include "ResultCache.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/BasicBlock.h"
@@ -16,6 +27,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/InstIterator.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 
 #include <iostream>
@@ -30,6 +42,12 @@
 using namespace cto;
 using namespace llvm;
 
+#define WIDENING_MAX_EXPONENT 63
+
+STATISTIC(NumRangeInstructions, "Number of instructions analyzed by the range analysis");
+STATISTIC(NumRangeVisits, "Number of instruction visits of the range analysis");
+STATISTIC(NumRangeUpdated, "Number of instructions analyzed again by the range updates");
+
 char FloatRangeAnalysis::ID = 0;
 static RegisterPass<FloatRangeAnalysis> X("float-range-analysis",
     "Floating point range analysis", false, false);
@@ -42,21 +60,170 @@ struct CtrlDep {
   BasicBlock *falsePath;
 };
 
-struct FloatRangeAlgorithm : public AnalysisAlgorithm<Range> {
+struct Constraint {
+  FCmpInst *condition;
+  bool isTrue;
+
+  Constraint(FCmpInst *condition, bool isTrue) : condition(condition), isTrue(isTrue) {
+  }
+};
 
-  FloatRangeAlgorithm(LoopInfo &loopInfo,
-                      ScalarEvolution &scev,
-                      DominatorTree &domTree,
-                      std::map<Value *, std::vector<CtrlDep> > controlDeps,
-                      result_set_t &initialRanges) :
-    AnalysisAlgorithm(loopInfo, scev),
+typedef ArrayRef<Constraint> constraint_list_t;
+
+// The branch conditions holding in each block, for each of their operands.
+// A condition holds in the blocks dominated by the path it selects, so the
+// table is filled by a single walk of the dominator tree, keeping the
+// conditions of the paths on the way from the root; the visits of the
+// algorithm then only look up the table. The lists are allocated in the
+// arena of the analysis.
+class ConstraintTable {
+public:
+  ConstraintTable(AnalysisArena &arena) : arena(arena) {
+  }
+
+  void compute(DominatorTreeBase<BasicBlock> &DT, const std::vector<CtrlDep> &controlDependencies) {
+    // The conditions selected by each path, grouped by block. Both operands
+    // of a comparison are constrained, unless they are constants.
+    for (std::vector<CtrlDep>::const_iterator dep = controlDependencies.begin(),
+         end = controlDependencies.end(); dep != end; ++dep) {
+      for (unsigned i = 0; i < 2; ++i) {
+        Value *operand = dep->condition->getOperand(i);
+        if (isa<Constant>(operand)) {
+          continue;
+        }
+        constrained.insert(operand);
+        if (dep->truePath) {
+          selections.push_back(Selection(dep->truePath, operand,
+                                         Constraint(dep->condition, true)));
+        }
+        if (dep->falsePath) {
+          selections.push_back(Selection(dep->falsePath, operand,
+                                         Constraint(dep->condition, false)));
+        }
+      }
+    }
+    if (selections.empty() || DT.getRootNode() == NULL) {
+      return;
+    }
+    std::sort(selections.begin(), selections.end(), isSelectedBefore);
+    for (unsigned i = 0; i < selections.size(); ++i) {
+      if (i == 0 || selections[i].path != selections[i - 1].path) {
+        firstSelection[selections[i].path] = i;
+      }
+    }
+
+    // Depth-first walk, with the conditions holding in the current block
+    std::vector<Frame> stack;
+    enter(DT.getRootNode(), stack);
+    while (!stack.empty()) {
+      if (stack.back().next == stack.back().node->end()) {
+        holding.erase(holding.begin() + stack.back().holding, holding.end());
+        stack.pop_back();
+        continue;
+      }
+      DomTreeNodeBase<BasicBlock> *child = *stack.back().next++;
+      enter(child, stack);
+    }
+  }
+
+  // Conditions holding in BB for val (none if the table has no entry)
+  inline constraint_list_t lookup(const BasicBlock *BB, const Value *val) const {
+    table_t::const_iterator found = table.find(std::make_pair(BB, val));
+    return found != table.end() ? found->second : constraint_list_t();
+  }
+
+  // Whether val is constrained by some condition
+  inline bool isConstrained(const Value *val) const {
+    return constrained.count(val) > 0;
+  }
+
+private:
+  typedef DenseMap<std::pair<const BasicBlock *, const Value *>, constraint_list_t> table_t;
+
+  struct Selection {
+    BasicBlock *path;
+    Value *operand;
+    Constraint constraint;
+
+    Selection(BasicBlock *path, Value *operand, const Constraint &constraint) :
+      path(path), operand(operand), constraint(constraint) {
+    }
+  };
+
+  struct Frame {
+    DomTreeNodeBase<BasicBlock> *node;
+    DomTreeNodeBase<BasicBlock>::iterator next;
+    // Number of conditions holding before the block
+    unsigned holding;
+  };
+
+  AnalysisArena &arena;
+  table_t table;
+  SmallPtrSet<const Value *, 16> constrained;
+  std::vector<Selection> selections;
+  DenseMap<const BasicBlock *, unsigned> firstSelection;
+  // Conditions holding in the current block, and the same sorted by operand
+  std::vector<Selection> holding;
+  std::vector<Selection> sorted;
+
+  static bool isSelectedBefore(const Selection &a, const Selection &b) {
+    return a.path < b.path;
+  }
+
+  static bool hasLowerOperand(const Selection &a, const Selection &b) {
+    return a.operand < b.operand;
+  }
+
+  void enter(DomTreeNodeBase<BasicBlock> *node, std::vector<Frame> &stack) {
+    Frame frame;
+    frame.node = node;
+    frame.next = node->begin();
+    frame.holding = holding.size();
+    stack.push_back(frame);
+
+    BasicBlock *BB = node->getBlock();
+    DenseMap<const BasicBlock *, unsigned>::iterator found = firstSelection.find(BB);
+    if (found != firstSelection.end()) {
+      for (unsigned i = found->second; i < selections.size() && selections[i].path == BB; ++i) {
+        holding.push_back(selections[i]);
+      }
+    }
+    // One list per operand
+    sorted.assign(holding.begin(), holding.end());
+    std::sort(sorted.begin(), sorted.end(), hasLowerOperand);
+    for (unsigned first = 0, last = 0; first < sorted.size(); first = last) {
+      while (last < sorted.size() && sorted[last].operand == sorted[first].operand) {
+        ++last;
+      }
+      Constraint *list = arena.allocate<Constraint>(last - first, sorted[first].constraint);
+      for (unsigned i = first; i < last; ++i) {
+        list[i - first] = sorted[i].constraint;
+      }
+      table[std::make_pair(BB, sorted[first].operand)] = constraint_list_t(list, last - first);
+    }
+  }
+};
+
+struct FloatRangeAlgorithm : public AnalysisAlgorithm<FloatRangeAlgorithm, Range> {
+
+  FloatRangeAlgorithm(LoopInfoBase<BasicBlock, Loop> &loopInfo,
+                      const TripCounts &tripCounts,
+                      DominatorTreeBase<BasicBlock> &domTree,
+                      const ConstraintTable &constraints,
+                      const ValueNumbering &numbering,
+                      const MemoryObjects &memory,
+                      AnalysisArena &arena,
+                      result_table_t &ranges,
+                      const std::vector<double> &thresholds,
+                      CallRangeOracle *oracle) :
+    AnalysisAlgorithm<FloatRangeAlgorithm, Range>(loopInfo, tripCounts, numbering, memory,
+                                                  arena, ranges),
     LI(loopInfo),
     domTree(domTree),
-    controlDependencies(controlDeps) {
-    for (result_set_t::iterator it = initialRanges.begin(),
-         end = initialRanges.end(); it != end; ++it) {
-      resultSet.insert(*it);
-    }
+    constraints(constraints),
+    visited(arena.allocate<bool>(numbering.size(), false)),
+    thresholds(thresholds),
+    oracle(oracle) {
   }
 
   Range visitFAdd(BinaryOperator &B) {
@@ -99,18 +266,165 @@ struct FloatRangeAlgorithm : public AnalysisAlgorithm<Range> {
     return ret;
   }
 
+  Range visitCast(CastInst &C) {
+    Value *operand = C.getOperand(0);
+    switch (C.getOpcode()) {
+    case Instruction::FPExt:
+      return getOperandRange(operand, C);
+    case Instruction::FPTrunc:
+      return roundToFloat(getOperandRange(operand, C));
+    default:
+      return getIntegerRange(operand, C.getOpcode() == Instruction::SIToFP);
+    }
+  }
+
+  // The arms compared by the condition are constrained as by a branch on
+  // it, so that a clamp such as x < lo ? lo : x is not below lo
+  Range visitSelect(SelectInst &S) {
+    Value *trueValue = S.getTrueValue();
+    Value *falseValue = S.getFalseValue();
+    Range r1 = getOperandRange(trueValue, S);
+    Range r2 = getOperandRange(falseValue, S);
+    if (FCmpInst *cmp = dyn_cast<FCmpInst>(S.getCondition())) {
+      if (trueValue == cmp->getOperand(0) || trueValue == cmp->getOperand(1))
+        r1 = constrainRange(r1, trueValue, cmp, true);
+      if (falseValue == cmp->getOperand(0) || falseValue == cmp->getOperand(1))
+        r2 = constrainRange(r2, falseValue, cmp, false);
+    }
+#ifdef TRACE_FLOAT_RANGE_ANALYSIS
+    errs() << "select: " << r1 << " | " << r2 << "\n";
+#endif
+    return r1 | r2;
+  }
+
+  // The lanes of the result are lanes of the floating point operands (the
+  // indices and the masks are not)
+  Range visitLaneOperation(Instruction &I) {
+    Range r = Range::Bottom();
+    for (User::op_iterator ops = I.op_begin(), opend = I.op_end(); ops != opend; ++ops) {
+      if (ops->get()->getType()->isFPOrFPVectorTy())
+        r = r | getOperandRange(ops->get(), I);
+    }
+    return r;
+  }
+
+  Range visitMathCall(CallInst &call, MathFunction fn) {
+    Range r1 = getOperandRange(call.getArgOperand(0), call);
+    if (r1.isBottom())
+      return r1;
+    switch (fn) {
+    case Fabs:
+      if (!r1.isValid())
+        return Range::Top;
+      if (r1.getMin() >= 0.0)
+        return r1;
+      if (r1.getMax() <= 0.0)
+        return Range(-r1.getMax(), -r1.getMin());
+      return Range(0.0, ::fmax(-r1.getMin(), r1.getMax()));
+    case Sqrt:
+      // The negative operands give NaN
+      if (!r1.isValid() || r1.getMax() < 0.0)
+        return Range::Top;
+      return Range(::sqrt(::fmax(r1.getMin(), 0.0)), ::sqrt(r1.getMax()));
+    case FMulAdd:
+      return r1 * getOperandRange(call.getArgOperand(1), call)
+             + getOperandRange(call.getArgOperand(2), call);
+    case FMin: {
+      Range r2 = getOperandRange(call.getArgOperand(1), call);
+      return Range(::fmin(r1.getMin(), r2.getMin()), ::fmin(r1.getMax(), r2.getMax()));
+    }
+    default: {
+      Range r2 = getOperandRange(call.getArgOperand(1), call);
+      return Range(::fmax(r1.getMin(), r2.getMin()), ::fmax(r1.getMax(), r2.getMax()));
+    }
+    }
+  }
+
+  // A load gives any of the values held by the object: its initial ones,
+  // and the ones written by the stores visited so far
+  Range visitLoad(LoadInst &L) {
+    const MemoryObjects::Object &object = memory.getObject(memory.lookup(&L));
+    Range r = object.Initial;
+    for (std::vector<StoreInst *>::const_iterator it = object.Stores.begin(),
+         end = object.Stores.end(); it != end; ++it) {
+      if (const Range *found = findResult(*it)) {
+        r = r | *found;
+      }
+    }
+#ifdef TRACE_FLOAT_RANGE_ANALYSIS
+    errs() << "load: " << r << "\n";
+#endif
+    return r;
+  }
+
+  Range visitStore(StoreInst &S) {
+    return getOperandRange(S.getValueOperand(), S);
+  }
+
+  // Binary operators are evaluated in batches, unless the range of an
+  // operand depends on a branch condition (whose operands may be in the
+  // same batch)
+  bool isBatchable(Instruction *inst) {
+    if (!isa<BinaryOperator>(inst))
+      return false;
+    return !constraints.isConstrained(inst->getOperand(0))
+           && !constraints.isConstrained(inst->getOperand(1));
+  }
+
+  void visitBatch(const std::vector<Instruction *> &insts, std::vector<Range> &results) {
+    for (unsigned op = 0; op < 4; ++op) {
+      batches[op].clear();
+    }
+    // Position of each result in the batches, or -1 if already computed
+    std::vector<int> positions(insts.size(), -1);
+    for (unsigned i = 0; i < insts.size(); ++i) {
+      BinaryOperator &B = *cast<BinaryOperator>(insts[i]);
+      Range r1 = getOperandRange(B.getOperand(0), B);
+      Range r2 = getOperandRange(B.getOperand(1), B);
+      if (!r1.isBottom() && !r2.isBottom()
+          && (B.getOpcode() != Instruction::FDiv || !r2.contains(0.0))) {
+        positions[i] = batches[getBatchIndex(B)].push(r1, r2);
+        results.push_back(Range::Top);
+      } else {
+        // Bottom and the divisions by zero are left to the scalar operators
+        results.push_back(evaluate(B, r1, r2));
+      }
+    }
+    batches[0].evaluate(RangeBatch::Add);
+    batches[1].evaluate(RangeBatch::Sub);
+    batches[2].evaluate(RangeBatch::Mul);
+    batches[3].evaluate(RangeBatch::Div);
+    for (unsigned i = 0; i < insts.size(); ++i) {
+      if (positions[i] >= 0) {
+        results[i] = batches[getBatchIndex(*cast<BinaryOperator>(insts[i]))].getResult(positions[i]);
+      }
+    }
+  }
+
   Range visitPhi(PHINode &PH) {
-    if (LI.isLoopHeader(PH.getParent()) && !visited[&PH]) {
+    Range summary;
+    if (summarizeRecurrence(PH, summary)) {
+      visited[numbering.lookup(&PH)] = true;
+#ifdef TRACE_FLOAT_RANGE_ANALYSIS
+      errs() << "recurrence: " << summary << "\n";
+#endif
+      return summary;
+    }
+    unsigned idx = numbering.lookup(&PH);
+    if (LI.isLoopHeader(PH.getParent()) && !visited[idx]) {
       // First time of the phi instruction in the loop header
       // => consider only first operand
-      visited[&PH] = true;
+      visited[idx] = true;
       Range r = Range::Top;
       bool foundSomething = false;
       for (unsigned int i = 0; i < PH.getNumOperands(); ++i) {
         Value *operand = PH.getOperand(i);
         // Avoid considering backedges in the first iteration of the loop
-        if (!isa<Instruction>(operand)
-            || domTree.dominates(dyn_cast<Instruction>(operand), &PH)) {
+        // (a definition dominating the header is defined before the loop)
+        Instruction *def = dyn_cast<Instruction>(operand);
+        if (def == NULL
+            || (def->getParent() != PH.getParent()
+                && domTree.dominates(def->getParent(), PH.getParent()))) {
           foundSomething = true;
           Range curRange = getOperandRange(operand, PH);
           if (r == Range::Top) {
@@ -142,12 +456,207 @@ struct FloatRangeAlgorithm : public AnalysisAlgorithm<Range> {
     return Range::Top;
   }
 
+  bool isCallSupported(CallInst &call) {
+    return oracle != NULL && oracle->handlesCall(call);
+  }
+
+  Range visitCall(CallInst &call) {
+    std::vector<Range> args;
+    for (unsigned i = 0; i < call.getNumArgOperands(); ++i) {
+      Value *arg = call.getArgOperand(i);
+      args.push_back(arg->getType()->isFloatingPointTy() ?
+                     getOperandRange(arg, call) : Range::Top);
+    }
+    return oracle->getReturnRange(call, args);
+  }
+
+  Range widen(const Range &previous, const Range &current) {
+    return previous.widen(current, thresholds);
+  }
+
+  Range narrow(const Range &previous, const Range &current) {
+    Range r = previous;
+    return r & current;
+  }
+
 private:
 
-  LoopInfo &LI;
-  DominatorTree &domTree;
-  std::map<Value *, std::vector<CtrlDep> > controlDependencies;
-  std::map<PHINode *, bool> visited;
+  LoopInfoBase<BasicBlock, Loop> &LI;
+  DominatorTreeBase<BasicBlock> &domTree;
+  const ConstraintTable &constraints;
+  // Whether each phi node was visited (only the loop headers matter)
+  bool *visited;
+  const std::vector<double> &thresholds;
+  CallRangeOracle *oracle;
+  // Operands of the instructions visited together, by opcode
+  RangeBatch batches[4];
+
+  static unsigned getBatchIndex(const BinaryOperator &B) {
+    switch (B.getOpcode()) {
+    case Instruction::FAdd:
+      return 0;
+    case Instruction::FSub:
+      return 1;
+    case Instruction::FMul:
+      return 2;
+    default:
+      return 3;
+    }
+  }
+
+  static Range evaluate(const BinaryOperator &B, Range r1, Range r2) {
+    switch (B.getOpcode()) {
+    case Instruction::FAdd:
+      return r1 + r2;
+    case Instruction::FSub:
+      return r1 - r2;
+    case Instruction::FMul:
+      return r1 * r2;
+    default:
+      return r1 / r2;
+    }
+  }
+
+  // Range of the float nearest to the values in r: the bounds are rounded
+  // outwards, and overflow to the infinities
+  static Range roundToFloat(const Range &r) {
+    if (!r.isValid())
+      return r;
+    float lo = static_cast<float>(r.getMin());
+    float hi = static_cast<float>(r.getMax());
+    if (lo > r.getMin())
+      lo = ::nextafterf(lo, -HUGE_VALF);
+    if (hi < r.getMax())
+      hi = ::nextafterf(hi, HUGE_VALF);
+    if (::fabs(lo) == HUGE_VALF || ::fabs(hi) == HUGE_VALF)
+      return Range::Top;
+    return Range(lo, hi);
+  }
+
+  // Integers converted to floating point: constants are exact, the other
+  // values can take any value of their type
+  static Range getIntegerRange(Value *val, bool isSigned) {
+    if (ConstantInt *CI = dyn_cast<ConstantInt>(val)) {
+      return Range(CI->getValue().roundToDouble(isSigned));
+    }
+    int bits = static_cast<int>(val->getType()->getScalarSizeInBits());
+    if (isSigned)
+      return Range(-::ldexp(1.0, bits - 1), ::ldexp(1.0, bits - 1) - 1.0);
+    return Range(0.0, ::ldexp(1.0, bits) - 1.0);
+  }
+
+  static bool isFinite(Range &r) {
+    return r.isValid() && ::fabs(r.getMin()) < HUGE_VAL && ::fabs(r.getMax()) < HUGE_VAL;
+  }
+
+  // Hull of the powers a^m, for 0 <= m <= n. For each x in a, |x|^m is
+  // monotonic in m, so the extremes are reached for m in {0, 1, n-1, n}.
+  static Range powerHull(Range a, uint64_t n) {
+    Range hull(1.0);
+    uint64_t exponents[3] = { 1, n > 0 ? n - 1 : 0, n };
+    for (unsigned i = 0; i < 3; ++i) {
+      if (exponents[i] > n || exponents[i] == 0)
+        continue;
+      double e = static_cast<double>(exponents[i]);
+      double lo = ::pow(a.getMin(), e);
+      double hi = ::pow(a.getMax(), e);
+      Range p(::fmin(lo, hi), ::fmax(lo, hi));
+      if (a.getMin() <= 0.0 && a.getMax() >= 0.0)
+        p = p | Range(0.0);
+      hull = hull | p;
+    }
+    return hull;
+  }
+
+  // Closed form for the loop-carried phi nodes following the recurrences
+  //   x = x * a,   x = x + k,   x = a * x + b
+  // with loop-invariant a, k, b: the range of the phi over the (statically
+  // known) N iterations is computed in one step, instead of visiting the
+  // body of the loop N times.
+  bool summarizeRecurrence(PHINode &PH, Range &summary) {
+    Loop *L = LI.getLoopFor(PH.getParent());
+    if (L == NULL || L->getHeader() != PH.getParent()
+        || PH.getNumIncomingValues() != 2 || L->getLoopLatch() == NULL)
+      return false;
+
+    int backedge = PH.getBasicBlockIndex(L->getLoopLatch());
+    if (backedge < 0 || L->contains(PH.getIncomingBlock(1 - backedge)))
+      return false;
+    Value *init = PH.getIncomingValue(1 - backedge);
+    BinaryOperator *next = dyn_cast<BinaryOperator>(PH.getIncomingValue(backedge));
+    if (next == NULL || !L->contains(next->getParent()))
+      return false;
+
+    OptionalValue<uint64_t> tripCount = getBackedgeTakenCount(L);
+    if (!tripCount.isValid())
+      return false;
+    uint64_t N = tripCount.get();
+
+    // Match next = a * x + b (a or b may be missing)
+    Value *a = NULL;
+    Value *b = NULL;
+    bool negateB = false;
+    BinaryOperator *mul = next;
+    if (next->getOpcode() == Instruction::FAdd || next->getOpcode() == Instruction::FSub) {
+      Value *lhs = next->getOperand(0);
+      Value *rhs = next->getOperand(1);
+      if (next->getOpcode() == Instruction::FAdd && L->isLoopInvariant(lhs)) {
+        std::swap(lhs, rhs);
+      }
+      if (!L->isLoopInvariant(rhs))
+        return false;
+      b = rhs;
+      negateB = next->getOpcode() == Instruction::FSub;
+      if (lhs == &PH) {
+        mul = NULL;
+      } else {
+        mul = dyn_cast<BinaryOperator>(lhs);
+      }
+    }
+    if (mul != NULL) {
+      if (mul->getOpcode() != Instruction::FMul)
+        return false;
+      if (mul->getOperand(0) == &PH) {
+        a = mul->getOperand(1);
+      } else if (mul->getOperand(1) == &PH) {
+        a = mul->getOperand(0);
+      } else {
+        return false;
+      }
+      if (!L->isLoopInvariant(a))
+        return false;
+    }
+
+    Range r0 = getOperandRange(init, PH);
+    Range ra = a ? getOperandRange(a, PH) : Range(1.0);
+    Range rb = b ? getOperandRange(b, PH) : Range(0.0);
+    if (!isFinite(r0) || !isFinite(ra) || !isFinite(rb))
+      return false;
+    if (negateB)
+      rb = Range(-rb.getMax(), -rb.getMin());
+
+    double n = static_cast<double>(N);
+    if (b == NULL) {
+      // x_m = x_0 * a^m
+      summary = r0 * powerHull(ra, N);
+    } else if (a == NULL || (ra.getMin() == 1.0 && ra.getMax() == 1.0)) {
+      // x_m = x_0 + m * b
+      Range steps = Range(0.0) | Range(n);
+      summary = r0 + ((rb * steps) | Range(0.0));
+    } else if (ra.getMin() == ra.getMax()) {
+      // x_m = a^m * x_0 + b * (1 - a^m) / (1 - a)
+      Range powers = powerHull(ra, N);
+      Range sums = Range(1.0 - powers.getMax(), 1.0 - powers.getMin())
+                   / Range(1.0 - ra.getMin());
+      summary = r0 * powers + rb * sums;
+    } else {
+      return false;
+    }
+
+    if (!isFinite(summary))
+      summary = Range::Top;
+    return true;
+  }
 
   Range constrainRange(Range &r, Value *operand, Value *condition, bool isTrue) {
     if (isa<FCmpInst>(condition)) {
@@ -158,7 +667,7 @@ private:
                      cmpCondition->getOperand(1) : cmpCondition->getOperand(0);
       Range otherRange = getOperandRange(other, *cmpCondition);
 
-      if (otherRange == Range::Top) // Can't say anything
+      if (!otherRange.isValid()) // Can't say anything
         return r;
 
       if (operand == cmpCondition->getOperand(1)) {
@@ -200,97 +709,399 @@ private:
 
   Range getOperandRange(Value *val, Instruction &context) {
     if (isa<Constant>(val)) {
-      if (ConstantFP *CFP = dyn_cast<ConstantFP>(val)) {
-        const APFloat &val = CFP->getValueAPF();
-        return Range(val.convertToDouble());
+      Range r;
+      if (getConstantRange(val, r)) {
+        return r;
       }
     } else {
-      result_set_t::iterator found = resultSet.find(val);
-      if (found != resultSet.end()) {
-        return refineWithControlDependencies(found->second, val, context);
+      if (const Range *found = findResult(val)) {
+        return refineWithControlDependencies(*found, val, context);
       }
     }
     return Range::Top;
   }
 
+  // Apply the branch conditions holding where the instruction is
   Range refineWithControlDependencies(Range r, Value *val, Instruction &context) {
-    // See if there is a control dependency involving this value...
-    std::map<Value *, std::vector<CtrlDep> >::iterator dependency =
-      controlDependencies.find(val);
-    if (dependency != controlDependencies.end()) {
-      for (std::vector<CtrlDep>::iterator it = dependency->second.begin();
-           it != dependency->second.end(); ++it) {
-        // ... that is effective during the current instruction ...
-        if (it->truePath
-            && (it->truePath == context.getParent()
-                || domTree.dominates(it->truePath, context.getParent()))) {
-          r = constrainRange(r, val, it->condition, true);
-        } else if (it->falsePath
-                   && (it->falsePath == context.getParent()
-                       || domTree.dominates(it->falsePath, context.getParent()))) {
-          r = constrainRange(r, val, it->condition, false);
-        }
+    constraint_list_t holding = constraints.lookup(context.getParent(), val);
+    for (constraint_list_t::iterator it = holding.begin(), end = holding.end(); it != end; ++it) {
+      r = constrainRange(r, val, it->condition, it->isTrue);
+    }
+    return r;
+  }
+};
+
+// Runs after FloatRangeAlgorithm, whose results bound the intervals of each
+// operand: the recurrences and the calls are thus taken into account, and
+// the operands not visited yet (backedges, and the values outside of the
+// slice being updated) just take their range. The branch conditions are not
+// applied to the operands, which are bounded by their own range rather than
+// by the one refined where they are used: the results only keep them
+// through the intersection with the ranges of FloatRangeAlgorithm.
+struct IntervalSetAlgorithm : public AnalysisAlgorithm<IntervalSetAlgorithm, IntervalSet> {
+
+  IntervalSetAlgorithm(LoopInfoBase<BasicBlock, Loop> &loopInfo,
+                       const TripCounts &tripCounts,
+                       const ValueNumbering &numbering,
+                       const MemoryObjects &memory,
+                       AnalysisArena &arena,
+                       result_table_t &sets,
+                       const range_store_t &ranges,
+                       const std::vector<double> &thresholds) :
+    AnalysisAlgorithm<IntervalSetAlgorithm, IntervalSet>(loopInfo, tripCounts, numbering,
+                                                         memory, arena, sets),
+    ranges(ranges),
+    thresholds(thresholds) {
+  }
+
+  IntervalSet visitFAdd(BinaryOperator &B) {
+    return getOperandSet(B.getOperand(0)) + getOperandSet(B.getOperand(1));
+  }
+
+  IntervalSet visitFSub(BinaryOperator &B) {
+    return getOperandSet(B.getOperand(0)) - getOperandSet(B.getOperand(1));
+  }
+
+  IntervalSet visitFMul(BinaryOperator &B) {
+    return getOperandSet(B.getOperand(0)) * getOperandSet(B.getOperand(1));
+  }
+
+  IntervalSet visitFDiv(BinaryOperator &B) {
+    return getOperandSet(B.getOperand(0)) / getOperandSet(B.getOperand(1));
+  }
+
+  IntervalSet visitCast(CastInst &C) {
+    if (C.getOpcode() == Instruction::FPExt)
+      return getOperandSet(C.getOperand(0));
+    return getRangeSet(&C);
+  }
+
+  IntervalSet visitSelect(SelectInst &S) {
+    return getOperandSet(S.getTrueValue()) | getOperandSet(S.getFalseValue());
+  }
+
+  IntervalSet visitLaneOperation(Instruction &I) {
+    return getRangeSet(&I);
+  }
+
+  IntervalSet visitMathCall(CallInst &call, MathFunction fn) {
+    if (fn == FMulAdd) {
+      return getOperandSet(call.getArgOperand(0)) * getOperandSet(call.getArgOperand(1))
+             + getOperandSet(call.getArgOperand(2));
+    }
+    return getRangeSet(&call);
+  }
+
+  IntervalSet visitLoad(LoadInst &L) {
+    const MemoryObjects::Object &object = memory.getObject(memory.lookup(&L));
+    IntervalSet res(object.Initial);
+    for (std::vector<StoreInst *>::const_iterator it = object.Stores.begin(),
+         end = object.Stores.end(); it != end; ++it) {
+      if (const IntervalSet *found = findResult(*it)) {
+        res = res | *found;
       }
     }
+    return res;
+  }
+
+  IntervalSet visitStore(StoreInst &S) {
+    return getOperandSet(S.getValueOperand());
+  }
+
+  IntervalSet visitPhi(PHINode &PH) {
+    IntervalSet res = getOperandSet(PH.getOperand(0));
+    for (unsigned int i = 1; i < PH.getNumOperands(); ++i)
+      res = res | getOperandSet(PH.getOperand(i));
+    return res;
+  }
+
+  IntervalSet getUnboundedResult() {
+    return IntervalSet();
+  }
+
+  IntervalSet widen(const IntervalSet &previous, const IntervalSet &current) {
+    return previous.widen(current, thresholds);
+  }
+
+  IntervalSet narrow(const IntervalSet &previous, const IntervalSet &current) {
+    return previous & current;
+  }
+
+private:
+  const range_store_t &ranges;
+  const std::vector<double> &thresholds;
+
+  // The range computed by FloatRangeAlgorithm, for the operations whose
+  // result is not split further
+  IntervalSet getRangeSet(Value *val) {
+    unsigned idx = numbering.lookup(val);
+    if (idx == ValueNumbering::NotNumbered || !ranges.has(idx)) {
+      return IntervalSet();
+    }
+    return IntervalSet(ranges.get(idx));
+  }
+
+  IntervalSet getOperandSet(Value *val) {
+    Range constant;
+    if (getConstantRange(val, constant)) {
+      return IntervalSet(constant);
+    }
+    unsigned idx = numbering.lookup(val);
+    if (idx == ValueNumbering::NotNumbered || !ranges.has(idx)) {
+      return IntervalSet();
+    }
+    IntervalSet r(ranges.get(idx));
+    if (const IntervalSet *found = findResult(val)) {
+      return *found & r;
+    }
     return r;
   }
 };
+
+// Runs after FloatRangeAlgorithm as IntervalSetAlgorithm. The operands not
+// visited yet, and the ones whose form is not within their range, are
+// represented by their range, depending on a noise symbol numbered as the
+// value. The phi nodes in the loop headers are represented the same way:
+// the values carried from the previous iteration do not share the noise
+// symbols with the current one, and the results are stable once the range
+// of the phi is.
+struct AffineRangeAlgorithm : public AnalysisAlgorithm<AffineRangeAlgorithm, AffineForm> {
+
+  AffineRangeAlgorithm(LoopInfoBase<BasicBlock, Loop> &loopInfo,
+                       const TripCounts &tripCounts,
+                       const ValueNumbering &numbering,
+                       const MemoryObjects &memory,
+                       AnalysisArena &arena,
+                       result_table_t &forms,
+                       const range_store_t &ranges,
+                       const std::vector<double> &thresholds) :
+    AnalysisAlgorithm<AffineRangeAlgorithm, AffineForm>(loopInfo, tripCounts, numbering,
+                                                        memory, arena, forms),
+    LI(loopInfo),
+    ranges(ranges),
+    thresholds(thresholds),
+    symbols(numbering.size()) {
+  }
+
+  AffineForm visitFAdd(BinaryOperator &B) {
+    return getOperandForm(B.getOperand(0)) + getOperandForm(B.getOperand(1));
+  }
+
+  AffineForm visitFSub(BinaryOperator &B) {
+    return getOperandForm(B.getOperand(0)) - getOperandForm(B.getOperand(1));
+  }
+
+  AffineForm visitFMul(BinaryOperator &B) {
+    return getOperandForm(B.getOperand(0)) * getOperandForm(B.getOperand(1));
+  }
+
+  AffineForm visitFDiv(BinaryOperator &B) {
+    return getOperandForm(B.getOperand(0)) / getOperandForm(B.getOperand(1));
+  }
+
+  AffineForm visitCast(CastInst &C) {
+    if (C.getOpcode() == Instruction::FPExt)
+      return getOperandForm(C.getOperand(0));
+    return getRangeForm(&C);
+  }
+
+  AffineForm visitSelect(SelectInst &S) {
+    return getOperandForm(S.getTrueValue()) | getOperandForm(S.getFalseValue());
+  }
+
+  AffineForm visitMathCall(CallInst &call, MathFunction fn) {
+    if (fn == FMulAdd) {
+      return getOperandForm(call.getArgOperand(0)) * getOperandForm(call.getArgOperand(1))
+             + getOperandForm(call.getArgOperand(2));
+    }
+    return getRangeForm(&call);
+  }
+
+  // The noise symbols of a vector stand for each of its lanes, and are
+  // correlated only with the same lanes of the other values: the lanes
+  // moved elsewhere are represented by their range
+  AffineForm visitLaneOperation(Instruction &I) {
+    return getRangeForm(&I);
+  }
+
+  // The elements of an object do not share their noise symbols, so a load
+  // is represented by its range as the loop header phi nodes
+  AffineForm visitLoad(LoadInst &L) {
+    return getRangeForm(&L);
+  }
+
+  AffineForm visitStore(StoreInst &S) {
+    return getOperandForm(S.getValueOperand());
+  }
+
+  AffineForm visitPhi(PHINode &PH) {
+    if (LI.isLoopHeader(PH.getParent())) {
+      Range r = Range::Bottom();
+      for (unsigned int i = 0; i < PH.getNumOperands(); ++i)
+        r = r | getOperandForm(PH.getOperand(i)).getRange();
+      unsigned idx = numbering.lookup(&PH);
+      if (ranges.has(idx))
+        r = r & ranges.get(idx);
+      return AffineForm::fromRange(r, idx, &symbols);
+    }
+    AffineForm res = getOperandForm(PH.getOperand(0));
+    for (unsigned int i = 1; i < PH.getNumOperands(); ++i)
+      res = res | getOperandForm(PH.getOperand(i));
+    return res;
+  }
+
+  AffineForm getUnboundedResult() {
+    return AffineForm();
+  }
+
+  // Only applied to the phi nodes in the loop headers
+  AffineForm widen(const AffineForm &previous, const AffineForm &current) {
+    Range r = previous.getRange().widen(current.getRange(), thresholds);
+    return r == previous.getRange() ? previous : rescale(previous, r);
+  }
+
+  AffineForm narrow(const AffineForm &previous, const AffineForm &current) {
+    Range r = previous.getRange() & current.getRange();
+    return r == current.getRange() ? current : rescale(current, r);
+  }
+
+private:
+  LoopInfoBase<BasicBlock, Loop> &LI;
+  const range_store_t &ranges;
+  const std::vector<double> &thresholds;
+  NoiseSymbols symbols;
+
+  // The form of a loop header phi for another range
+  AffineForm rescale(const AffineForm &form, const Range &r) {
+    unsigned symbol = form.getNumTerms() > 0 ? form.getSymbol(0) : symbols.fresh();
+    return AffineForm::fromRange(r, symbol, &symbols);
+  }
+
+  // Form of the range computed by FloatRangeAlgorithm, for the operations
+  // that are not linear
+  AffineForm getRangeForm(Value *val) {
+    unsigned idx = numbering.lookup(val);
+    if (idx == ValueNumbering::NotNumbered || !ranges.has(idx)) {
+      return AffineForm();
+    }
+    return AffineForm::fromRange(ranges.get(idx), idx, &symbols);
+  }
+
+  AffineForm getOperandForm(Value *val) {
+    if (ConstantFP *CFP = dyn_cast<ConstantFP>(val)) {
+      return AffineForm(CFP->getValueAPF().convertToDouble());
+    }
+    // The lanes of a vector constant differ
+    Range constant;
+    if (getConstantRange(val, constant)) {
+      return AffineForm::fromRange(constant, symbols.fresh(), &symbols);
+    }
+    unsigned idx = numbering.lookup(val);
+    if (idx == ValueNumbering::NotNumbered || !ranges.has(idx)) {
+      return AffineForm();
+    }
+    Range r = ranges.get(idx);
+    if (const AffineForm *found = findResult(val)) {
+      Range formRange = found->getRange();
+      if ((formRange & r) == formRange)
+        return *found;
+    }
+    return AffineForm::fromRange(r, idx, &symbols);
+  }
+};
 }
 
-OptionalValue<uint64_t> FloatRangeAnalysis::computeBitsForValue(const Value &V) {
-  if (Store.find(&V) != Store.end() || isa<const llvm::ConstantFP>(V)) {
-    Range r = getRange(&V);
-    if (r.isBottom()) {
-      return 0;  // this most likely is an always false condition...
-    }
-    if (r.isValid()) {
-      // Note: we assume a two's complement fixed point representation as a target.
-      // For the sake of simplicity, we also consider 64 bits as the maximum possible word length.
-      // ceil() is because the approximation of the decimal part may add one unit to the integer part
-      // The "+1" if get{Min,Max}() is positive is because two's complement representation
-      // has the range [-2^N, +2^N-1].
-      double rmin = ::ceil(r.getMin() < 0 ? ::abs(r.getMin()) : r.getMin() + 1);
-      double rmax = ::ceil(r.getMax() < 0 ? ::abs(r.getMax()) : r.getMax() + 1);
-      uint64_t bitwidth = static_cast<uint64_t>(::ceil(::log2(::fmax(rmin, rmax))) + 1);
-      return OptionalValue<uint64_t>(bitwidth);
-    } else {
-      return OptionalValue<uint64_t>::invalid();
+// Intersect the ranges computed by FloatRangeAlgorithm with the ones of the
+// Algorithm on the domain T, which starts from them
+template <typename Algorithm, typename T>
+static void refineRanges(Function &F,
+                         LoopInfoBase<BasicBlock, Loop> &LI,
+                         const TripCounts &TC,
+                         const std::vector<double> &thresholds,
+                         AnalysisArena &arena,
+                         FunctionRanges &result) {
+  const BitVector &slice = result.Updated;
+  ResultTable<T> refined;
+  refined.reset(result.Numbering.size(), T());
+  Algorithm refinement(LI, TC, result.Numbering, result.Memory, arena, refined, result.Store,
+                       thresholds);
+  if (slice.all()) {
+    refinement.analyze(F);
+  } else {
+    refinement.analyze(F, slice);
+  }
+  NumRangeVisits += refinement.getNumVisits();
+  // Both results are sound, so the values get their intersection
+  for (int idx = slice.find_first(); idx >= 0; idx = slice.find_next(idx)) {
+    if (refined.has(idx) && result.Store.has(idx)) {
+      result.Store.set(idx, result.Store.get(idx) & refined.get(idx).getRange());
     }
   }
+}
+
+static OptionalValue<uint64_t> computeBitsForValue(const FunctionRanges &ranges,
+                                                   const Value &V) {
+  Range constant;
+  if (ranges.Store.has(ranges.Numbering.lookup(&V)) || getConstantRange(&V, constant)) {
+    // An empty range most likely is an always false condition...
+    return getIntegerBits(ranges.getRange(&V));
+  }
   // else, fake 0 minimum bits for instructions not supported
   // (function calls, integer, annotations, ...), so that max is not affected
   return OptionalValue<uint64_t>(0);
 }
 
-OptionalValue<uint64_t> FloatRangeAnalysis::computeMinimumBits(const Function &F) {
+// Only the values in the FP slice can have a range, and the other operands
+// of its instructions are either in the slice or not floating point
+static OptionalValue<uint64_t> computeMinimumBits(const FunctionRanges &ranges) {
   OptionalValue<uint64_t> res(0);
-  for (const_inst_iterator Itr = inst_begin(F), IEnd = inst_end(F);
-       Itr != IEnd; ++Itr) {
-    //XXX avoid visiting unsupported instructions
-    //    (although this is needed now to consider operands to floating point
-    //     comparisons, which will be converted)
-    res = max(computeBitsForValue(*Itr), res);
-    for (Instruction::const_op_iterator ops = Itr->op_begin(), opend =
-           Itr->op_end(); ops != opend; ++ops) {
-      res = max(computeBitsForValue(*(ops->get())), res);
-    }
-    if (!res.isValid())
-      break;
+  for (std::vector<unsigned>::const_iterator idx = ranges.FPSlice.begin(),
+       end = ranges.FPSlice.end(); idx != end && res.isValid(); ++idx) {
+    const Value *val = ranges.Numbering.getValue(*idx);
+    res = max(computeBitsForValue(ranges, *val), res);
+    // Constants are not numbered, but are converted as well
+    if (const Instruction *I = dyn_cast<Instruction>(val)) {
+      for (Instruction::const_op_iterator ops = I->op_begin(), opend = I->op_end();
+           ops != opend; ++ops) {
+        if (isa<Constant>(ops->get())) {
+          res = max(computeBitsForValue(ranges, *(ops->get())), res);
+        }
+      }
+    }
   }
   return res;
 }
 
-bool FloatRangeAnalysis::runOnFunction(Function &F) {
-
-  ScalarEvolution &SCEV = getAnalysis<ScalarEvolution>();
-  LoopInfo &LI = getAnalysis<LoopInfo>();
-  DominatorTree &DomTree = getAnalysis<DominatorTree>();
+// The bounds of llvm.float.range are double constants
+static double getAnnotationBound(Value *bound) {
+  ConstantFP *CFP = dyn_cast<ConstantFP>(bound);
+  assert(CFP != NULL && "Min and max are not constants!");
+  return CFP->getValueAPF().convertToDouble();
+}
 
-  // Initialization
-  FloatRangeAlgorithm::result_set_t knownRanges;
-  std::map<Value *, std::vector<CtrlDep> > controlDependencies;
+// Scan the function for the annotated ranges, the branch conditions that
+// constrain the ranges of their operands, and the widening thresholds
+static void collectFunctionInfo(Function &F,
+                                const input_ranges_t *inputRanges,
+                                std::map<const Value *, Range> &knownRanges,
+                                std::vector<CtrlDep> &controlDependencies,
+                                std::vector<double> &thresholds) {
+  std::vector<Value *> inputs;
+  for (Function::arg_iterator A = F.arg_begin(), AE = F.arg_end(); A != AE; ++A) {
+    inputs.push_back(&*A);
+  }
   for (inst_iterator Itr = inst_begin(F), IEnd = inst_end(F); Itr != IEnd; ++Itr) {
 
+    // Widening thresholds: the constants appearing in the function
+    for (Instruction::op_iterator ops = Itr->op_begin(), opend = Itr->op_end();
+         ops != opend; ++ops) {
+      if (ConstantFP *CFP = dyn_cast<ConstantFP>(ops->get())) {
+        double k = CFP->getValueAPF().convertToDouble();
+        thresholds.push_back(k);
+        thresholds.push_back(-k);
+      }
+    }
+
     // Populate the data structure to refine the ranges according to branch conditions
     if (BranchInst *BI = dyn_cast<BranchInst>(&(*Itr))) {
       if (BI->isConditional()) {
@@ -311,9 +1122,8 @@ bool FloatRangeAnalysis::runOnFunction(Function &F) {
           }
           // Sanity check
           if (dep.truePath != dep.falsePath && (dep.truePath || dep.falsePath)) {
-            // we add the constraint to all the operands predicated by this condition
-            controlDependencies[Binop->getOperand(0)].push_back(dep);
-            controlDependencies[Binop->getOperand(1)].push_back(dep);
+            // the constraint applies to both the operands of the condition
+            controlDependencies.push_back(dep);
           }
         }
       }
@@ -325,32 +1135,442 @@ bool FloatRangeAnalysis::runOnFunction(Function &F) {
       continue;
     Value *calledFunction = Itr->getOperand(Itr->getNumOperands() - 1);
     if (calledFunction->getName().str().find("llvm.float.range") != 0) {
+      inputs.push_back(&*Itr);
       continue;
     }
     Value *annotatedValue = Itr->getOperand(0);
-    ConstantInt *CIMin = dyn_cast<llvm::ConstantInt>(Itr->getOperand(1));
-    ConstantInt *CIMax = dyn_cast<llvm::ConstantInt>(Itr->getOperand(2));
-    assert(CIMin != NULL && CIMax != NULL && "Min and max are not ConstantInts!");
-    Range r(CIMin->getSExtValue(), CIMax->getSExtValue());
+    Range r(getAnnotationBound(Itr->getOperand(1)), getAnnotationBound(Itr->getOperand(2)));
     knownRanges[annotatedValue] = r;
+    if (!r.isValid())
+      continue;
+    thresholds.push_back(r.getMin());
+    thresholds.push_back(-r.getMin());
+    thresholds.push_back(r.getMax());
+    thresholds.push_back(-r.getMax());
+  }
+  // The ranges coming from the rest of the module refine the annotated ones
+  if (inputRanges != NULL) {
+    for (std::vector<Value *>::iterator it = inputs.begin(), end = inputs.end();
+         it != end; ++it) {
+      input_ranges_t::const_iterator found = inputRanges->find(*it);
+      if (found == inputRanges->end())
+        continue;
+      Range r = found->second;
+      std::map<const Value *, Range>::iterator known = knownRanges.find(*it);
+      if (known != knownRanges.end()) {
+        r = r & known->second;
+        if (!r.isValid())
+          continue;
+      }
+      knownRanges[*it] = r;
+      thresholds.push_back(r.getMin());
+      thresholds.push_back(-r.getMin());
+      thresholds.push_back(r.getMax());
+      thresholds.push_back(-r.getMax());
+    }
+  }
+  // Powers of two, as the integer bitwidth only depends on the magnitude
+  // of the bounds: widening to them costs at most one bit.
+  thresholds.push_back(0.0);
+  for (int i = 0; i < WIDENING_MAX_EXPONENT; ++i) {
+    thresholds.push_back(::ldexp(1.0, i));
+    thresholds.push_back(-::ldexp(1.0, i));
   }
+  std::sort(thresholds.begin(), thresholds.end());
+  thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+}
 
-  FloatRangeAlgorithm algorithm(LI, SCEV, DomTree, controlDependencies, knownRanges);
+// What the values held by a memory object depend on: the loads and stores
+// of the object share it. As the signatures, it is computed from the
+// numbers of the values (and the names of the globals).
+static hash_code hashObject(const MemoryObjects::Object &object, const ValueNumbering &Numbering) {
+  unsigned base = Numbering.lookup(object.Base);
+  hash_code h = base != ValueNumbering::NotNumbered ? hash_value(base)
+                : hash_value(object.Base->getName());
+  h = hash_combine(h, DoubleToBits(object.Initial.getMin()),
+                   DoubleToBits(object.Initial.getMax()));
+  for (std::vector<StoreInst *>::const_iterator it = object.Stores.begin(),
+       end = object.Stores.end(); it != end; ++it) {
+    h = hash_combine(h, Numbering.lookup(*it));
+  }
+  return h;
+}
 
-  algorithm.analyze(inst_begin(F), inst_end(F));
+// The result of a value only depends on its opcode and operands, and the
+// one of a load on the object it reads
+static void computeSignatures(Function &F, FunctionRanges &result) {
+  const ValueNumbering &Numbering = result.Numbering;
+  ResultCache::computeSignatures(F, Numbering, result.Signatures);
+  std::vector<size_t> objectSignatures;
+  for (unsigned i = 0; i < result.Memory.size(); ++i) {
+    objectSignatures.push_back(hashObject(result.Memory.getObject(i), Numbering));
+  }
+  for (unsigned idx = Numbering.getNumArguments(); idx < Numbering.size(); ++idx) {
+    unsigned object = result.Memory.lookup(Numbering.getValue(idx));
+    if (object != MemoryObjects::NotTracked) {
+      result.Signatures[idx] = hash_combine(result.Signatures[idx], objectSignatures[object]);
+    }
+  }
+}
 
-  FloatRangeAlgorithm::result_set_t res = algorithm.getResult();
-  for (FloatRangeAlgorithm::result_set_t::iterator it = res.begin(), end = res.end(); it != end; ++it) {
-    Store.insert(std::make_pair<const Value *, Range>(it->first, it->second));
+// The known ranges by the number of their values (the ones of a previous
+// analysis are only compared as keys, as they may have been deleted)
+static std::map<unsigned, Range> getKnownRangesAt(const FunctionRanges &ranges) {
+  std::map<unsigned, Range> res;
+  for (std::map<const Value *, Range>::const_iterator it = ranges.KnownRanges.begin(),
+       end = ranges.KnownRanges.end(); it != end; ++it) {
+    unsigned idx = ranges.Numbering.lookup(it->first);
+    if (idx != ValueNumbering::NotNumbered) {
+      res.insert(std::make_pair(idx, it->second));
+    }
   }
+  return res;
+}
 
-  minimumBits.insert(std::make_pair<const Function *, OptionalValue<uint64_t> >(&F, computeMinimumBits(F)));
+// The floating point values used in the function, and the instructions
+// using floating point values
+static void computeFPSlice(FunctionRanges &result) {
+  const ValueNumbering &Numbering = result.Numbering;
+  result.FPSlice.clear();
+  for (unsigned idx = 0; idx < Numbering.getNumArguments(); ++idx) {
+    Value *arg = Numbering.getValue(idx);
+    if (arg->getType()->isFPOrFPVectorTy() && !arg->use_empty()) {
+      result.FPSlice.push_back(idx);
+    }
+  }
+  for (unsigned idx = Numbering.getNumArguments(); idx < Numbering.size(); ++idx) {
+    Instruction *I = cast<Instruction>(Numbering.getValue(idx));
+    bool inSlice = I->getType()->isFPOrFPVectorTy();
+    for (User::op_iterator ops = I->op_begin(), opend = I->op_end();
+         ops != opend && !inSlice; ++ops) {
+      inSlice = ops->get()->getType()->isFPOrFPVectorTy();
+    }
+    if (inSlice) {
+      result.FPSlice.push_back(idx);
+    }
+  }
+}
+
+// Add to the slice the values whose range may depend on the given ones
+static void addForwardSlice(const ValueNumbering &Numbering,
+                            const MemoryObjects &Memory,
+                            std::vector<Value *> &pending,
+                            BitVector &slice) {
+  while (!pending.empty()) {
+    Value *val = pending.back();
+    pending.pop_back();
+    unsigned idx = Numbering.lookup(val);
+    if (idx == ValueNumbering::NotNumbered || slice.test(idx)) {
+      continue;
+    }
+    slice.set(idx);
+    // The loads of an object read its stores
+    unsigned object = Memory.lookup(val);
+    if (object != MemoryObjects::NotTracked && isa<StoreInst>(val)) {
+      const std::vector<LoadInst *> &loads = Memory.getObject(object).Loads;
+      pending.insert(pending.end(), loads.begin(), loads.end());
+    }
+    for (Value::use_iterator u = val->use_begin(), e = val->use_end(); u != e; ++u) {
+      pending.push_back(*u);
+      // The ranges of the operands of a comparison are refined by each other
+      // where the branch it controls is taken
+      if (FCmpInst *cmp = dyn_cast<FCmpInst>(*u)) {
+        for (unsigned i = 0; i < 2; ++i) {
+          Value *operand = cmp->getOperand(i);
+          if (operand == val || isa<Constant>(operand)) {
+            continue;
+          }
+          for (Value::use_iterator ou = operand->use_begin(), oe = operand->use_end();
+               ou != oe; ++ou) {
+            pending.push_back(*ou);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void runAlgorithm(Function &F,
+                         LoopInfoBase<BasicBlock, Loop> &LI,
+                         DominatorTreeBase<BasicBlock> &DT,
+                         const TripCounts &TC,
+                         const std::vector<CtrlDep> &controlDependencies,
+                         const std::vector<double> &thresholds,
+                         CallRangeOracle *oracle,
+                         AnalysisArena &arena,
+                         FunctionRanges &result) {
+  const BitVector &slice = result.Updated;
+  for (std::map<const Value *, Range>::iterator it = result.KnownRanges.begin(),
+       end = result.KnownRanges.end(); it != end; ++it) {
+    unsigned idx = result.Numbering.lookup(it->first);
+    if (idx != ValueNumbering::NotNumbered && slice.test(idx)) {
+      result.Store.set(idx, it->second);
+    }
+  }
+
+  ConstraintTable constraints(arena);
+  constraints.compute(DT, controlDependencies);
+
+  // The algorithm writes its results directly into Store
+  FloatRangeAlgorithm algorithm(LI, TC, DT, constraints, result.Numbering,
+                                result.Memory, arena, result.Store, thresholds, oracle);
+
+  if (slice.all()) {
+    algorithm.analyze(F);
+  } else {
+    algorithm.analyze(F, slice);
+  }
+  NumRangeInstructions += algorithm.getNumInstructions();
+  NumRangeVisits += algorithm.getNumVisits();
+
+  switch (getRangeDomain()) {
+  case IntervalSetDomain:
+    refineRanges<IntervalSetAlgorithm, IntervalSet>(F, LI, TC, thresholds, arena, result);
+    break;
+  case AffineDomain:
+    refineRanges<AffineRangeAlgorithm, AffineForm>(F, LI, TC, thresholds, arena, result);
+    break;
+  default:
+    break;
+  }
+
+  result.MinimumBits = computeMinimumBits(result);
+}
+
+// The internal globals written by F are only tracked when it is analyzed
+// out of a calling context: the analysis in a context (given by the input
+// ranges, or the oracle of the summaries) does not see the values stored by
+// the calls in the other contexts
+static bool tracksWritableGlobals(const input_ranges_t *inputRanges, CallRangeOracle *oracle) {
+  return inputRanges == NULL && oracle == NULL;
+}
+
+void FloatRangeAnalysis::computeRanges(Function &F,
+                                       LoopInfoBase<BasicBlock, Loop> &LI,
+                                       DominatorTreeBase<BasicBlock> &DT,
+                                       const TripCounts &TC,
+                                       FunctionRanges &result,
+                                       const input_ranges_t *inputRanges,
+                                       CallRangeOracle *oracle,
+                                       AnalysisArena *arena) {
+  AnalysisArena localArena;
+  if (arena == NULL) {
+    arena = &localArena;
+  }
+  arena->reset();
+
+  // Initialization
+  result.Numbering.number(F);
+  result.Store.reset(result.Numbering.size(), Range::Top);
+  result.KnownRanges.clear();
+  result.Updated.clear();
+  result.Updated.resize(result.Numbering.size(), true);
+  result.Renumbered = true;
+  ++result.Generation;
+  result.CacheKey = 0;
+  result.PreviousKey = 0;
+  result.Memory.compute(F, tracksWritableGlobals(inputRanges, oracle));
+  computeSignatures(F, result);
+  computeFPSlice(result);
+
+  std::vector<CtrlDep> controlDependencies;
+  std::vector<double> thresholds;
+  collectFunctionInfo(F, inputRanges, result.KnownRanges, controlDependencies, thresholds);
+
+  runAlgorithm(F, LI, DT, TC, controlDependencies, thresholds, oracle, *arena, result);
+}
+
+// Analyze the values of F whose signature or known range differs from the
+// ones of a previous version of F, keeping the results of the others
+static void reanalyzeChanged(Function &F,
+                             LoopInfoBase<BasicBlock, Loop> &LI,
+                             DominatorTreeBase<BasicBlock> &DT,
+                             const TripCounts &TC,
+                             const input_ranges_t *inputRanges,
+                             const std::vector<uint64_t> &previousSignatures,
+                             const range_store_t &previousStore,
+                             const std::map<unsigned, Range> &previousKnown,
+                             AnalysisArena &arena,
+                             FunctionRanges &result) {
+  result.Numbering.number(F);
+  unsigned size = result.Numbering.size();
+  result.Store.reset(size, Range::Top);
+  result.Renumbered = size != previousSignatures.size();
+  result.CacheKey = 0;
+  result.Memory.compute(F, tracksWritableGlobals(inputRanges, NULL));
+  computeSignatures(F, result);
+  computeFPSlice(result);
+
+  std::vector<CtrlDep> controlDependencies;
+  std::vector<double> thresholds;
+  collectFunctionInfo(F, inputRanges, result.KnownRanges, controlDependencies, thresholds);
+
+  // Keep the results of the unchanged values, and start from the others: a
+  // value is the one with the same number in the previous analysis, if
+  // they have the same signature (which also covers their operands)
+  std::vector<Value *> changed;
+  for (unsigned idx = 0; idx < size; ++idx) {
+    Value *val = result.Numbering.getValue(idx);
+    if (idx >= previousSignatures.size() || previousSignatures[idx] != result.Signatures[idx]) {
+      changed.push_back(val);
+    } else if (previousStore.has(idx)) {
+      result.Store.set(idx, previousStore.get(idx));
+    }
+  }
+  std::map<unsigned, Range> known = getKnownRangesAt(result);
+  for (std::map<unsigned, Range>::iterator it = known.begin(), end = known.end();
+       it != end; ++it) {
+    std::map<unsigned, Range>::const_iterator found = previousKnown.find(it->first);
+    if (found == previousKnown.end() || found->second != it->second) {
+      changed.push_back(result.Numbering.getValue(it->first));
+    }
+  }
+  for (std::map<unsigned, Range>::const_iterator it = previousKnown.begin(),
+       end = previousKnown.end(); it != end; ++it) {
+    if (it->first < size && known.count(it->first) == 0) {
+      changed.push_back(result.Numbering.getValue(it->first));
+    }
+  }
+
+  result.Updated.clear();
+  result.Updated.resize(size);
+  addForwardSlice(result.Numbering, result.Memory, changed, result.Updated);
+  for (int idx = result.Updated.find_first(); idx >= 0; idx = result.Updated.find_next(idx)) {
+    result.Store.unset(idx);
+  }
+
+  DEBUG(errs() << "Updating " << result.Updated.count() << " of " << size
+        << " ranges in " << F.getName() << "\n");
+  NumRangeUpdated += result.Updated.count();
+
+  runAlgorithm(F, LI, DT, TC, controlDependencies, thresholds, NULL, arena, result);
+}
+
+void FloatRangeAnalysis::updateRanges(Function &F,
+                                      LoopInfoBase<BasicBlock, Loop> &LI,
+                                      DominatorTreeBase<BasicBlock> &DT,
+                                      const TripCounts &TC,
+                                      FunctionRanges &result,
+                                      const input_ranges_t *inputRanges,
+                                      AnalysisArena *arena) {
+  if (result.Numbering.size() == 0) {
+    computeRanges(F, LI, DT, TC, result, inputRanges, NULL, arena);
+    return;
+  }
+  AnalysisArena localArena;
+  if (arena == NULL) {
+    arena = &localArena;
+  }
+  arena->reset();
+
+  FunctionRanges previous;
+  previous.swap(result);
+  result.Generation = previous.Generation + 1;
+  result.PreviousKey = 0;
+  reanalyzeChanged(F, LI, DT, TC, inputRanges, previous.Signatures, previous.Store,
+                   getKnownRangesAt(previous), *arena, result);
+}
+
+// Update the cached results of the last version of F, when the analysis
+// has not kept any: the functions edited since the last run are analyzed
+// again only in the forward slice of their changes
+static bool updateFromCache(Function &F,
+                            LoopInfoBase<BasicBlock, Loop> &LI,
+                            DominatorTreeBase<BasicBlock> &DT,
+                            const TripCounts &TC,
+                            const input_ranges_t *inputRanges,
+                            AnalysisArena &arena,
+                            FunctionRanges &result) {
+  ResultCache::FunctionVersion version;
+  range_store_t previousStore;
+  OptionalValue<uint64_t> previousBits = OptionalValue<uint64_t>::invalid();
+  if (!ResultCache::loadVersion(F, inputRanges != NULL, version)
+      || !ResultCache::loadRanges(version.Key, version.Signatures.size(), previousStore,
+                                  previousBits))
+    return false;
+
+  arena.reset();
+  ++result.Generation;
+  result.PreviousKey = version.Key;
+  reanalyzeChanged(F, LI, DT, TC, inputRanges, version.Signatures, previousStore,
+                   version.KnownRanges, arena, result);
+  return true;
+}
+
+// Look for the results of the function in the persistent cache: on a hit,
+// they replace the ones in result as a full (re)analysis would
+static bool loadFromCache(Function &F,
+                          const input_ranges_t *inputRanges,
+                          FunctionRanges &result,
+                          uint64_t &key) {
+  FunctionRanges cached;
+  cached.Numbering.number(F);
+  key = ResultCache::computeKey(F, cached.Numbering, inputRanges);
+  if (!ResultCache::loadRanges(key, cached.Numbering.size(), cached.Store, cached.MinimumBits))
+    return false;
+
+  std::vector<CtrlDep> controlDependencies;
+  std::vector<double> thresholds;
+  collectFunctionInfo(F, inputRanges, cached.KnownRanges, controlDependencies, thresholds);
+  cached.Memory.compute(F, tracksWritableGlobals(inputRanges, NULL));
+  computeSignatures(F, cached);
+  computeFPSlice(cached);
+  cached.Updated.resize(cached.Numbering.size(), true);
+  cached.Renumbered = true;
+  cached.Generation = result.Generation + 1;
+  cached.CacheKey = key;
+  result.swap(cached);
+  return true;
+}
+
+bool FloatRangeAnalysis::runOnFunction(Function &F) {
+  Ranges = &Results[&F];
+
+  // Adopt the results of the module-level driver, if it already ran
+  ParallelAnalysisDriver *Driver = getAnalysisIfAvailable<ParallelAnalysisDriver>();
+  if (Driver == NULL || !Driver->takeRanges(F, *Ranges)) {
+    ScalarEvolution &SCEV = getAnalysis<ScalarEvolution>();
+    LoopInfo &LI = getAnalysis<LoopInfo>();
+    DominatorTree &DomTree = getAnalysis<DominatorTree>();
+    TripCounts TC;
+    TC.compute(LI, SCEV);
+    InterproceduralRangeAnalysis *IPA = getAnalysisIfAvailable<InterproceduralRangeAnalysis>();
+    const input_ranges_t *inputRanges = IPA != NULL ? &IPA->getInputRanges() : NULL;
+    uint64_t key = 0;
+    if (!ResultCache::isEnabled()) {
+      updateRanges(F, LI.getBase(), DomTree.getBase(), TC, *Ranges, inputRanges, &Arena);
+    } else if (!loadFromCache(F, inputRanges, *Ranges, key)) {
+      if (Ranges->Numbering.size() != 0
+          || !updateFromCache(F, LI.getBase(), DomTree.getBase(), TC, inputRanges, Arena,
+                              *Ranges)) {
+        updateRanges(F, LI.getBase(), DomTree.getBase(), TC, *Ranges, inputRanges, &Arena);
+      }
+      ResultCache::storeRanges(key, Ranges->Store, Ranges->MinimumBits);
+      Ranges->CacheKey = key;
+      ResultCache::FunctionVersion version;
+      version.Key = key;
+      version.Signatures = Ranges->Signatures;
+      version.KnownRanges = getKnownRangesAt(*Ranges);
+      ResultCache::storeVersion(F, inputRanges != NULL, version);
+    }
+  }
+
+  // OptionalValue has no default constructor, so operator[] cannot be used
+  minimumBits.erase(&F);
+  minimumBits.insert(std::make_pair(&F, Ranges->MinimumBits));
 
   DEBUG(printAll(F));
 
   return false; /* analysis pass, do not change anything */
 }
 
+void FloatRangeAnalysis::releaseMemory() {
+  Results.clear();
+  minimumBits.clear();
+  Ranges = NULL;
+  Arena.reset();
+}
+
 OptionalValue<uint64_t> FloatRangeAnalysis::getMinimumIntegerBitWidth(const Function &F) const {
   std::map<const Function *, OptionalValue<uint64_t> >::const_iterator found = minimumBits.find(&F);
   if (found != minimumBits.end()) {
@@ -363,9 +1583,9 @@ void FloatRangeAnalysis::printAll(const Function &F) const {
   errs() << "Printing ranges for the function " << F.getName() << "\n\n";
   for (const_inst_iterator BI = inst_begin(F), BE = inst_end(F); BI != BE; ++BI) {
     const Instruction *I = &(*BI);
-    std::map<const llvm::Value *, Range>::const_iterator res = Store.find(I);
-    if (res != Store.end()) {
-      errs() << res->second;
+    unsigned idx = Ranges->Numbering.lookup(I);
+    if (Ranges->Store.has(idx)) {
+      errs() << Ranges->Store.get(idx);
     }
     I->print(errs());
     errs() << '\n';
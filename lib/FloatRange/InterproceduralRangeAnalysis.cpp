@@ -0,0 +1,220 @@
+#define DEBUG_TYPE "float-range-ipa"
+
+#include "InterproceduralRangeAnalysis.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <vector>
+
+using namespace cto;
+using namespace llvm;
+
+STATISTIC(NumSummaries, "Number of function summaries computed");
+STATISTIC(NumSummaryHits, "Number of calls resolved by a cached summary");
+
+static cl::opt<unsigned> MaxContexts("float-range-ipa-contexts", cl::init(4),
+    cl::desc("Maximum number of distinct argument ranges a function is "
+             "analyzed with; further calls assume unknown arguments."));
+
+char InterproceduralRangeAnalysis::ID = 0;
+static RegisterPass<InterproceduralRangeAnalysis> X("float-range-ipa",
+    "Interprocedural floating point range analysis", false, true);
+
+namespace {
+
+typedef std::vector<Range> context_t;
+
+// The loop information of each function is computed once, and reused for
+// all the contexts it is analyzed with.
+struct FunctionState {
+  TripCounts TC;
+  DominatorTreeBase<BasicBlock> DT;
+  LoopInfoBase<BasicBlock, Loop> LI;
+  std::map<context_t, Range> summaries;
+  bool onStack;
+
+  FunctionState() : DT(false), onStack(false) {
+  }
+};
+
+class SummaryCache : public CallRangeOracle {
+public:
+  SummaryCache() {
+  }
+
+  virtual ~SummaryCache() {
+    for (std::map<const Function *, FunctionState *>::iterator it = states.begin(),
+         end = states.end(); it != end; ++it) {
+      delete it->second;
+    }
+  }
+
+  void addFunction(Function &F, LoopInfo &LI, ScalarEvolution &SE) {
+    FunctionState *state = new FunctionState();
+    state->TC.compute(LI, SE);
+    state->DT.recalculate(F);
+    state->LI.Analyze(state->DT);
+    states[&F] = state;
+  }
+
+  // Range of the value returned by F when called with the given arguments
+  Range getSummary(Function &F, context_t context);
+
+  bool handlesCall(const CallInst &call) {
+    const Function *callee = call.getCalledFunction();
+    return callee != NULL && call.getType()->isFloatingPointTy()
+           && states.count(callee) > 0;
+  }
+
+  Range getReturnRange(CallInst &call, const std::vector<Range> &args) {
+    Range r = getSummary(*call.getCalledFunction(), args);
+    std::map<const CallInst *, Range>::iterator found = callRanges.find(&call);
+    if (found == callRanges.end()) {
+      callRanges[&call] = r;
+    } else {
+      found->second = found->second | r;
+    }
+    return r;
+  }
+
+  void exportRanges(input_ranges_t &inputRanges) const;
+
+private:
+  bool allCallsVisited(const Function &F) const;
+
+  std::map<const Function *, FunctionState *> states;
+  std::map<const Argument *, Range> argRanges;
+  std::map<const CallInst *, Range> callRanges;
+};
+
+Range SummaryCache::getSummary(Function &F, context_t context) {
+  FunctionState &state = *states[&F];
+  // The arguments take the values of every call, even the ones that are
+  // not summarized
+  unsigned i = 0;
+  for (Function::arg_iterator A = F.arg_begin(), AE = F.arg_end(); A != AE; ++A, ++i) {
+    std::map<const Argument *, Range>::iterator joined = argRanges.find(&*A);
+    if (joined == argRanges.end()) {
+      argRanges[&*A] = context[i];
+    } else {
+      joined->second = joined->second | context[i];
+    }
+  }
+
+  // Recursive calls are not summarized
+  if (state.onStack) {
+    return Range::Top;
+  }
+  std::map<context_t, Range>::iterator found = state.summaries.find(context);
+  if (found != state.summaries.end()) {
+    ++NumSummaryHits;
+    return found->second;
+  }
+  if (state.summaries.size() >= MaxContexts) {
+    context.assign(context.size(), Range::Top);
+    found = state.summaries.find(context);
+    if (found != state.summaries.end()) {
+      ++NumSummaryHits;
+      return found->second;
+    }
+  }
+
+  input_ranges_t inputs;
+  i = 0;
+  for (Function::arg_iterator A = F.arg_begin(), AE = F.arg_end(); A != AE; ++A, ++i) {
+    if (context[i].isValid()) {
+      inputs[&*A] = context[i];
+    }
+  }
+
+  state.onStack = true;
+  FunctionRanges ranges;
+  FloatRangeAnalysis::computeRanges(F, state.LI, state.DT, state.TC, ranges,
+                                    &inputs, this);
+  state.onStack = false;
+
+  Range summary = Range::Bottom();
+  if (!F.getReturnType()->isFloatingPointTy()) {
+    summary = Range::Top;
+  }
+  for (Function::iterator BB = F.begin(), BE = F.end(); BB != BE; ++BB) {
+    if (ReturnInst *RI = dyn_cast<ReturnInst>(BB->getTerminator())) {
+      if (RI->getReturnValue() != NULL) {
+        summary = summary | ranges.getRange(RI->getReturnValue());
+      }
+    }
+  }
+
+  DEBUG(errs() << "Summary of " << F.getName() << ": " << summary << "\n");
+  ++NumSummaries;
+  state.summaries[context] = summary;
+  return summary;
+}
+
+// Whether the arguments of every call of F have been seen: the calls that
+// are not visited (not returning a floating point value, or in code the
+// analysis does not reach) can pass any value
+bool SummaryCache::allCallsVisited(const Function &F) const {
+  for (Value::const_use_iterator u = F.use_begin(), e = F.use_end(); u != e; ++u) {
+    const CallInst *call = dyn_cast<CallInst>(*u);
+    if (call == NULL || callRanges.count(call) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SummaryCache::exportRanges(input_ranges_t &inputRanges) const {
+  // The arguments of the functions that can be called from outside of the
+  // module, or indirectly, can have any value
+  for (std::map<const Argument *, Range>::const_iterator it = argRanges.begin(),
+       end = argRanges.end(); it != end; ++it) {
+    const Function *F = it->first->getParent();
+    Range r = it->second;
+    if (F->hasLocalLinkage() && !F->hasAddressTaken() && r.isValid()
+        && allCallsVisited(*F)) {
+      inputRanges[it->first] = r;
+    }
+  }
+  for (std::map<const CallInst *, Range>::const_iterator it = callRanges.begin(),
+       end = callRanges.end(); it != end; ++it) {
+    Range r = it->second;
+    if (r.isValid()) {
+      inputRanges[it->first] = r;
+    }
+  }
+}
+
+bool isEntryPoint(const Function &F) {
+  return !F.hasLocalLinkage() || F.hasAddressTaken();
+}
+
+}
+
+bool InterproceduralRangeAnalysis::runOnModule(Module &M) {
+  inputRanges.clear();
+  SummaryCache cache;
+
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (!F->isDeclaration()) {
+      cache.addFunction(*F, getAnalysis<LoopInfo>(*F), getAnalysis<ScalarEvolution>(*F));
+    }
+  }
+
+  // The functions that are only called directly from within the module are
+  // analyzed in the contexts of their call sites
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (!F->isDeclaration() && isEntryPoint(*F)) {
+      cache.getSummary(*F, context_t(F->arg_size(), Range::Top));
+    }
+  }
+
+  cache.exportRanges(inputRanges);
+  return false; /* analysis pass, do not change anything */
+}
@@ -0,0 +1,145 @@
+#include "IntervalSet.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace cto;
+
+IntervalSet IntervalSet::fromRanges(Range *ranges, unsigned n) {
+  // Drop the empty ranges, sort the others and merge the overlapping ones
+  Range *end = std::remove_if(ranges, ranges + n, std::mem_fun_ref(&Range::isBottom));
+  std::sort(ranges, end);
+  unsigned size = 0;
+  for (Range *it = ranges; it != end; ++it) {
+    if (size > 0 && it->getMin() <= ranges[size - 1].getMax()) {
+      ranges[size - 1] = ranges[size - 1] | *it;
+    } else {
+      ranges[size++] = *it;
+    }
+  }
+
+  // Merge the closest intervals until they fit
+  while (size > MaxIntervals) {
+    unsigned closest = 0;
+    for (unsigned i = 1; i + 1 < size; ++i) {
+      if (ranges[i + 1].getMin() - ranges[i].getMax()
+          < ranges[closest + 1].getMin() - ranges[closest].getMax()) {
+        closest = i;
+      }
+    }
+    ranges[closest] = ranges[closest] | ranges[closest + 1];
+    std::copy(ranges + closest + 2, ranges + size, ranges + closest + 1);
+    --size;
+  }
+
+  IntervalSet res = Bottom();
+  std::copy(ranges, ranges + size, res.intervals);
+  res.count = size;
+  return res;
+}
+
+// Division by an interval containing zero gives Top, which absorbs the
+// other intervals when they are merged
+IntervalSet IntervalSet::apply(Operation op, const IntervalSet &rhs) const {
+  Range results[MaxIntervals * MaxIntervals];
+  unsigned n = 0;
+  for (unsigned i = 0; i < count; ++i) {
+    for (unsigned j = 0; j < rhs.count; ++j) {
+      const Range &a = intervals[i];
+      const Range &b = rhs.intervals[j];
+      switch (op) {
+      case Add:
+        results[n++] = a + b;
+        break;
+      case Sub:
+        results[n++] = a - b;
+        break;
+      case Mul:
+        results[n++] = a * b;
+        break;
+      case Div:
+        results[n++] = a / b;
+        break;
+      }
+    }
+  }
+  // An empty operand gives no result, i.e. Bottom
+  return fromRanges(results, n);
+}
+
+IntervalSet IntervalSet::operator+(const IntervalSet &rhs) const {
+  return apply(Add, rhs);
+}
+
+IntervalSet IntervalSet::operator-(const IntervalSet &rhs) const {
+  return apply(Sub, rhs);
+}
+
+IntervalSet IntervalSet::operator*(const IntervalSet &rhs) const {
+  return apply(Mul, rhs);
+}
+
+IntervalSet IntervalSet::operator/(const IntervalSet &rhs) const {
+  return apply(Div, rhs);
+}
+
+IntervalSet IntervalSet::operator|(const IntervalSet &rhs) const {
+  Range ranges[2 * MaxIntervals];
+  std::copy(intervals, intervals + count, ranges);
+  std::copy(rhs.intervals, rhs.intervals + rhs.count, ranges + count);
+  return fromRanges(ranges, count + rhs.count);
+}
+
+IntervalSet IntervalSet::operator&(const IntervalSet &rhs) const {
+  Range ranges[MaxIntervals * MaxIntervals];
+  unsigned n = 0;
+  for (unsigned i = 0; i < count; ++i) {
+    for (unsigned j = 0; j < rhs.count; ++j) {
+      ranges[n++] = intervals[i] & rhs.intervals[j];
+    }
+  }
+  return fromRanges(ranges, n);
+}
+
+bool IntervalSet::operator==(const IntervalSet &rhs) const {
+  return count == rhs.count && std::equal(intervals, intervals + count, rhs.intervals);
+}
+
+IntervalSet IntervalSet::widen(const IntervalSet &next,
+                               const std::vector<double> &thresholds) const {
+  if (isBottom())
+    return next;
+  if ((*this | next) == *this)
+    return *this;
+  return IntervalSet(getRange().widen(next.getRange(), thresholds));
+}
+
+Range IntervalSet::getRange() const {
+  if (isBottom())
+    return Range::Bottom();
+  return Range(intervals[0].getMin(), intervals[count - 1].getMax());
+}
+
+namespace cto {
+
+std::ostream &operator<<(std::ostream &os, const IntervalSet &obj) {
+  if (obj.isBottom()) {
+    return os << "[Bottom]";
+  }
+  for (unsigned i = 0; i < obj.count; ++i) {
+    os << (i > 0 ? " U " : "") << obj.intervals[i];
+  }
+  return os;
+}
+
+llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const IntervalSet &obj) {
+  if (obj.isBottom()) {
+    return os << "[Bottom]";
+  }
+  for (unsigned i = 0; i < obj.count; ++i) {
+    os << (i > 0 ? " U " : "") << obj.intervals[i];
+  }
+  return os;
+}
+
+}
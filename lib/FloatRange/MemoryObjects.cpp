@@ -0,0 +1,197 @@
+#include "MemoryObjects.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Support/InstIterator.h"
+
+using namespace llvm;
+using namespace cto;
+
+const unsigned MemoryObjects::NotTracked;
+
+namespace {
+
+// Floating point type of the elements, or NULL if other values are held
+Type *getElementType(Type *type) {
+  while (ArrayType *AT = dyn_cast<ArrayType>(type)) {
+    type = AT->getElementType();
+  }
+  return type->isFloatingPointTy() ? type : NULL;
+}
+
+// Hull of the values of a constant (Top if they are not floating point)
+Range getConstantRange(const Constant *C) {
+  if (const ConstantFP *CFP = dyn_cast<ConstantFP>(C)) {
+    APFloat val = CFP->getValueAPF();
+    bool losesInfo;
+    val.convert(APFloat::IEEEdouble, APFloat::rmNearestTiesToEven, &losesInfo);
+    return Range(val.convertToDouble());
+  }
+  if (isa<UndefValue>(C)) {
+    return Range::Bottom();
+  }
+  if (C->isNullValue()) {
+    return Range(0.0);
+  }
+  Range hull = Range::Bottom();
+  if (const ConstantDataSequential *CDS = dyn_cast<ConstantDataSequential>(C)) {
+    for (unsigned i = 0; i < CDS->getNumElements(); ++i) {
+      hull = hull | getConstantRange(CDS->getElementAsConstant(i));
+    }
+    return hull;
+  }
+  if (isa<ConstantArray>(C)) {
+    for (User::const_op_iterator ops = C->op_begin(), opend = C->op_end(); ops != opend; ++ops) {
+      hull = hull | getConstantRange(cast<Constant>(ops->get()));
+    }
+    return hull;
+  }
+  return Range::Top;
+}
+
+// Uses of a cast of the pointer to the object: the zeroing memsets, the
+// copies from a constant, and the lifetime markers
+bool collectIntrinsicUses(Value *ptr, Type *elementType, Function &F,
+                          MemoryObjects::Object &object) {
+  for (Value::use_iterator u = ptr->use_begin(), e = ptr->use_end(); u != e; ++u) {
+    IntrinsicInst *II = dyn_cast<IntrinsicInst>(*u);
+    if (II == NULL || II->getParent()->getParent() != &F) {
+      return false;
+    }
+    switch (II->getIntrinsicID()) {
+    case Intrinsic::lifetime_start:
+    case Intrinsic::lifetime_end:
+      break;
+    case Intrinsic::memset: {
+      MemSetInst *MS = cast<MemSetInst>(II);
+      ConstantInt *val = dyn_cast<ConstantInt>(MS->getValue());
+      if (MS->getRawDest() != ptr || val == NULL || !val->isZero()) {
+        return false;
+      }
+      // Only the memsets of whole elements are rewritten
+      ConstantInt *length = dyn_cast<ConstantInt>(MS->getLength());
+      if (length == NULL
+          || length->getZExtValue() % (elementType->getPrimitiveSizeInBits() / 8) != 0) {
+        object.Rewritable = false;
+      }
+      object.Initial = object.Initial | Range(0.0);
+      object.Clears.push_back(MS);
+      break;
+    }
+    case Intrinsic::memcpy:
+    case Intrinsic::memmove: {
+      MemTransferInst *MT = cast<MemTransferInst>(II);
+      GlobalVariable *source = dyn_cast<GlobalVariable>(MT->getRawSource()->stripPointerCasts());
+      if (MT->getRawDest() != ptr || source == NULL || !source->isConstant()
+          || !source->hasDefinitiveInitializer()) {
+        return false;
+      }
+      object.Initial = object.Initial | getConstantRange(source->getInitializer());
+      object.Rewritable = false;
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+// Loads and stores of the object through ptr: false if the pointer escapes
+// (it is stored, merged or passed to a call) or an element is accessed as
+// another type. The constants cannot be changed, so only their loads in the
+// function matter.
+bool collectAccesses(Value *ptr, Type *elementType, Function &F, bool isConstant,
+                     MemoryObjects::Object &object) {
+  for (Value::use_iterator u = ptr->use_begin(), e = ptr->use_end(); u != e; ++u) {
+    User *user = *u;
+    if (Instruction *I = dyn_cast<Instruction>(user)) {
+      if (I->getParent()->getParent() != &F) {
+        if (isConstant)
+          continue;
+        return false;
+      }
+    }
+    if (LoadInst *L = dyn_cast<LoadInst>(user)) {
+      if (L->isVolatile() || L->getType() != elementType) {
+        return false;
+      }
+      object.Loads.push_back(L);
+    } else if (StoreInst *S = dyn_cast<StoreInst>(user)) {
+      if (isConstant || S->isVolatile() || S->getValueOperand() == ptr
+          || S->getValueOperand()->getType() != elementType) {
+        return false;
+      }
+      object.Stores.push_back(S);
+    } else if (isa<GEPOperator>(user)) {
+      // Constant expressions are not rewritten
+      if (!isa<Instruction>(user)) {
+        object.Rewritable = false;
+      }
+      if (!collectAccesses(user, elementType, F, isConstant, object)) {
+        return false;
+      }
+    } else if (isConstant) {
+      continue;
+    } else if (isa<BitCastOperator>(user)) {
+      if (!collectIntrinsicUses(user, elementType, F, object)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+void MemoryObjects::addObject(Value *base, Type *type, const Range &initial, Function &F) {
+  Type *elementType = getElementType(type);
+  if (elementType == NULL) {
+    return;
+  }
+  Object object(base, initial);
+  object.Rewritable = isa<AllocaInst>(base)
+                      && (elementType->isFloatTy() || elementType->isDoubleTy());
+  GlobalVariable *global = dyn_cast<GlobalVariable>(base);
+  bool isConstant = global != NULL && global->isConstant();
+  if (!collectAccesses(base, elementType, F, isConstant, object)
+      || (object.Loads.empty() && object.Stores.empty())) {
+    return;
+  }
+  unsigned idx = objects.size();
+  objects.push_back(object);
+  for (std::vector<LoadInst *>::iterator it = object.Loads.begin(), end = object.Loads.end();
+       it != end; ++it) {
+    accesses[*it] = idx;
+  }
+  for (std::vector<StoreInst *>::iterator it = object.Stores.begin(), end = object.Stores.end();
+       it != end; ++it) {
+    accesses[*it] = idx;
+  }
+}
+
+void MemoryObjects::compute(Function &F, bool writableGlobals) {
+  objects.clear();
+  accesses.clear();
+
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(&*I)) {
+      addObject(AI, AI->getAllocatedType(), Range::Bottom(), F);
+    }
+  }
+  // The non-constant globals can only be tracked if the function is the
+  // only one using them: the stores of its previous calls are then known
+  Module *M = F.getParent();
+  for (Module::global_iterator G = M->global_begin(), GE = M->global_end(); G != GE; ++G) {
+    if (G->use_empty() || !G->hasDefinitiveInitializer()
+        || (!G->isConstant() && (!G->hasLocalLinkage() || !writableGlobals))) {
+      continue;
+    }
+    addObject(&*G, G->getType()->getElementType(), getConstantRange(G->getInitializer()), F);
+  }
+}
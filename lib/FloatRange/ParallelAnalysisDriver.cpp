@@ -0,0 +1,188 @@
+#define DEBUG_TYPE "float-range-parallel"
+
+#include "ParallelAnalysisDriver.h"
+#include "InterproceduralRangeAnalysis.h"
+#include "ResultCache.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Support/Atomic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace cto;
+using namespace llvm;
+
+STATISTIC(NumParallelFunctions, "Number of functions analyzed by the parallel driver");
+STATISTIC(NumParallelThreads, "Number of threads used by the parallel driver");
+
+static cl::opt<unsigned> NumThreads("float-range-threads", cl::init(0),
+    cl::desc("Number of threads used by -float-range-parallel "
+             "(0 = number of online processors)."));
+
+char ParallelAnalysisDriver::ID = 0;
+static RegisterPass<ParallelAnalysisDriver> X("float-range-parallel",
+    "Parallel range and precision analysis of all the functions", false, true);
+
+namespace {
+
+struct WorkerState {
+  std::vector<ParallelAnalysisDriver::Job *> *jobs;
+  volatile sys::cas_flag next;
+};
+
+double now() {
+  sys::TimeValue t = sys::TimeValue::now();
+  return t.seconds() + t.nanoseconds() / 1e9;
+}
+
+// Structural hash of the IR of F, to tell whether it changed since the
+// analysis (the input ranges are not part of it)
+uint64_t computeKey(Function &F) {
+  ValueNumbering numbering;
+  numbering.number(F);
+  return ResultCache::computeKey(F, numbering, NULL);
+}
+
+// The dominator tree and the loop information are rebuilt for each function
+// by the thread analyzing it, as the ones of the pass manager are shared.
+// Each thread has its own arena, reused by all of its jobs.
+void runJob(ParallelAnalysisDriver::Job &job, AnalysisArena &arena) {
+  double start = now();
+  DominatorTreeBase<BasicBlock> DT(false);
+  DT.recalculate(*job.F);
+  LoopInfoBase<BasicBlock, Loop> LI;
+  LI.Analyze(DT);
+  FloatRangeAnalysis::computeRanges(*job.F, LI, DT, job.TC, job.Ranges, job.Inputs,
+                                    NULL, &arena);
+  PrecisionAnalysis::computeErrors(*job.F, LI, job.TC, job.Ranges, job.Errors, &arena);
+  job.Seconds = now() - start;
+}
+
+void *worker(void *arg) {
+  WorkerState *state = static_cast<WorkerState *>(arg);
+  AnalysisArena arena;
+  for (;;) {
+    unsigned idx = sys::AtomicIncrement(&state->next) - 1;
+    if (idx >= state->jobs->size())
+      break;
+    runJob(*(*state->jobs)[idx], arena);
+  }
+  return NULL;
+}
+
+}
+
+ParallelAnalysisDriver::~ParallelAnalysisDriver() {
+  clearJobs();
+}
+
+void ParallelAnalysisDriver::clearJobs() {
+  for (std::vector<Job *>::iterator it = jobs.begin(), end = jobs.end(); it != end; ++it) {
+    delete *it;
+  }
+  jobs.clear();
+  jobIndex.clear();
+}
+
+bool ParallelAnalysisDriver::runOnModule(Module &M) {
+  clearJobs();
+
+  InterproceduralRangeAnalysis *IPA = getAnalysisIfAvailable<InterproceduralRangeAnalysis>();
+
+  // ScalarEvolution is not thread safe: the trip counts are computed upfront
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    Job *job = new Job(&*F, computeKey(*F));
+    job->Inputs = IPA != NULL ? &IPA->getInputRanges() : NULL;
+    job->TC.compute(getAnalysis<LoopInfo>(*F), getAnalysis<ScalarEvolution>(*F));
+    jobs.push_back(job);
+    jobIndex[&*F] = job;
+  }
+
+  unsigned threads = NumThreads;
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = online > 0 ? static_cast<unsigned>(online) : 1;
+  }
+  if (threads > jobs.size())
+    threads = jobs.size();
+  if (threads > 1 && !llvm_start_multithreaded())
+    threads = 1;
+
+  WorkerState state;
+  state.jobs = &jobs;
+  state.next = 0;
+
+  double start = now();
+  std::vector<pthread_t> workers;
+  for (unsigned i = 1; i < threads; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker, &state) != 0)
+      break;
+    workers.push_back(thread);
+  }
+  // The current thread takes part in the analysis as well
+  worker(&state);
+  for (std::vector<pthread_t>::iterator it = workers.begin(), end = workers.end();
+       it != end; ++it) {
+    pthread_join(*it, NULL);
+  }
+  double elapsed = now() - start;
+
+  double sequential = 0.0;
+  for (std::vector<Job *>::iterator it = jobs.begin(), end = jobs.end(); it != end; ++it) {
+    sequential += (*it)->Seconds;
+    DEBUG(errs() << (*it)->F->getName() << ": "
+          << format("%.6f", (*it)->Seconds) << " s\n");
+  }
+  double speedup = elapsed > 0.0 ? sequential / elapsed : 1.0;
+  unsigned used = workers.size() + 1;
+  NumParallelFunctions += jobs.size();
+  NumParallelThreads += used;
+  DEBUG(errs() << "float-range-parallel: " << jobs.size() << " functions analyzed on "
+        << used << " threads in " << format("%.3f", elapsed) << " s ("
+        << format("%.3f", sequential) << " s of analysis, speedup "
+        << format("%.2f", speedup) << "x, efficiency "
+        << format("%.0f", 100.0 * speedup / used) << "%)\n");
+
+  return false; /* analysis pass, do not change anything */
+}
+
+ParallelAnalysisDriver::Job *ParallelAnalysisDriver::findJob(const Function &F) const {
+  DenseMap<const Function *, Job *>::const_iterator found = jobIndex.find(&F);
+  if (found == jobIndex.end())
+    return NULL;
+  // Passes scheduled in between may have changed the function
+  if (found->second->Key != computeKey(const_cast<Function &>(F)))
+    return NULL;
+  return found->second;
+}
+
+bool ParallelAnalysisDriver::takeRanges(const Function &F, FunctionRanges &ranges) {
+  Job *job = findJob(F);
+  if (job == NULL || job->RangesTaken)
+    return false;
+  ranges.swap(job->Ranges);
+  job->RangesTaken = true;
+  return true;
+}
+
+bool ParallelAnalysisDriver::takeErrors(const Function &F, FunctionErrors &errors) {
+  // The errors are indexed by the numbering handed over with the ranges
+  Job *job = findJob(F);
+  if (job == NULL || !job->RangesTaken)
+    return false;
+  errors.swap(job->Errors);
+  // Both results have been handed over
+  jobIndex.erase(&F);
+  return true;
+}
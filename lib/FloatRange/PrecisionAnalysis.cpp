@@ -2,8 +2,12 @@
 
 #include "PrecisionAnalysis.h"
 
-#include "AnalysisAlgorithm.h"
+#include "AffineForm.h"
+#include "AnalysisAlgorithmImpl.h"
+#include "ParallelAnalysisDriver.h"
+#include "ResultCache.h"
 
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/InstVisitor.h"
 #include "llvm/IR/Instructions.h"
@@ -19,152 +23,764 @@
 using namespace cto;
 using namespace llvm;
 
+STATISTIC(NumErrorInstructions, "Number of instructions analyzed by the precision analysis");
+STATISTIC(NumErrorVisits, "Number of instruction visits of the precision analysis");
+
 char PrecisionAnalysis::ID = 0;
 static RegisterPass<PrecisionAnalysis> X("precision-analysis", "Precision analysis", false, false);
 
 namespace {
 
-class PrecisionAnalysisAlgorithm : public AnalysisAlgorithm<OptionalValue<double> > {
+// For constants, simulate conversion to fixed point and use the difference
+// as a precision loss
+double getConversionError(const ConstantFP &CFP, int decimalBitWidth) {
+  const APFloat &val = CFP.getValueAPF();
+  double dval = val.convertToDouble();
+  int64_t fixpoint = static_cast<int64_t>(ldexp(dval, decimalBitWidth));
+  double converted = ldexp(static_cast<double>(fixpoint), -decimalBitWidth);
+  return dval - converted;
+}
+
+// The largest error of the lanes of a vector constant (the undefined lanes
+// have none)
+double getConversionError(const Constant &C, int decimalBitWidth) {
+  if (const ConstantFP *CFP = dyn_cast<ConstantFP>(&C)) {
+    return getConversionError(*CFP, decimalBitWidth);
+  }
+  VectorType *type = dyn_cast<VectorType>(C.getType());
+  assert(type != NULL && type->getElementType()->isFloatingPointTy()
+         && "Analysing floating point precision of a non-floating-point constant!");
+  double res = 0.0;
+  for (unsigned i = 0; i < type->getNumElements(); ++i) {
+    if (const ConstantFP *CFP = dyn_cast_or_null<ConstantFP>(C.getAggregateElement(i))) {
+      res = fmax(res, fabs(getConversionError(*CFP, decimalBitWidth)));
+    }
+  }
+  return res;
+}
+
+class PrecisionAnalysisAlgorithm :
+  public AnalysisAlgorithm<PrecisionAnalysisAlgorithm, OptionalValue<double> > {
+  // The transfer functions are called by the base class
+  friend class AnalysisAlgorithm<PrecisionAnalysisAlgorithm, OptionalValue<double> >;
+
 public:
 
   PrecisionAnalysisAlgorithm(
-    LoopInfo &loopInfo,
-    ScalarEvolution &scev,
-    FloatRangeAnalysis &floatRange,
-    uint64_t decimalBitWidth) :
-    AnalysisAlgorithm<OptionalValue<double> >(loopInfo, scev),
-    FRA(floatRange),
-    decimalBitWidth(decimalBitWidth),
-    maxError(0.0) {
+    LoopInfoBase<BasicBlock, Loop> &loopInfo,
+    const TripCounts &tripCounts,
+    const FunctionRanges &ranges,
+    AnalysisArena &arena,
+    result_table_t &errors,
+    result_table_t &peaks) :
+    AnalysisAlgorithm<PrecisionAnalysisAlgorithm, OptionalValue<double> >(
+      loopInfo, tripCounts, ranges.Numbering, ranges.Memory, arena, errors),
+    LI(loopInfo),
+    ranges(ranges),
+    peaks(peaks),
+    formats(ranges) {
   }
 
   OptionalValue<double> getUnboundedResult() {
     return OptionalValue<double>::invalid();
   }
 
-  OptionalValue<double> getMaxError() {
-    return maxError;
+  // Errors that are still growing are widened to the next power of two:
+  // contracting recurrences (e.g. filters) then stabilize below a threshold,
+  // while diverging ones quickly exceed the word length and become unbounded.
+  OptionalValue<double> widen(const OptionalValue<double> &previous,
+                              const OptionalValue<double> &current) {
+    if (!previous.isValid() || !current.isValid())
+      return OptionalValue<double>::invalid();
+    if (current.get() <= previous.get())
+      return previous;
+    double exponent = ceil(log2(current.get()));
+    if (exponent > WORD_LENGTH)
+      return OptionalValue<double>::invalid();
+    return OptionalValue<double>(ldexp(1.0, static_cast<int>(exponent)));
   }
 
-  virtual ~PrecisionAnalysisAlgorithm() {
-
+  // An error that was widened to unbounded stays unbounded: phi nodes ignore
+  // invalid incoming errors, so recomputing it would drop the backedges.
+  OptionalValue<double> narrow(const OptionalValue<double> &previous,
+                               const OptionalValue<double> &current) {
+    if (!previous.isValid() || !current.isValid())
+      return previous;
+    return OptionalValue<double>(fmin(previous.get(), current.get()));
   }
 
 private:
-  FloatRangeAnalysis &FRA;
-  uint64_t decimalBitWidth;
-  OptionalValue<double> maxError;
-
-  OptionalValue<double> update(OptionalValue<double> val) {
-    maxError = max(val, maxError);
+  LoopInfoBase<BasicBlock, Loop> &LI;
+  const FunctionRanges &ranges;
+  result_table_t &peaks;
+  FixedPointFormats formats;
+
+  OptionalValue<double> update(Instruction &I, OptionalValue<double> val) {
+    unsigned idx = numbering.lookup(&I);
+    peaks.set(idx, peaks.has(idx) ? max(val, peaks.get(idx)) : val);
     return val;
   }
 
   /* return the maximum absolute value in range of val*/
   OptionalValue<double> getRangeMax(Value *val) {
-    Range r = FRA.getRange(val);
+    Range r = ranges.getRange(val);
     if (r.isValid())
       return OptionalValue<double>(fmax(fabs(r.getMin()), fabs(r.getMax())));
     return OptionalValue<double>::invalid();
   }
 
-  OptionalValue<double> getQuantError() {
-    // Note: static_cast<int> is necessary because decimalBitWidth is an unsigned!
-    return pow(2, (-1) * static_cast<int>(decimalBitWidth));
+  // Quantization error of the format of val
+  OptionalValue<double> getQuantError(Value *val) {
+    return ldexp(1.0, -formats.getFormat(val));
   }
 
   OptionalValue<double> getError(Value *val) {
-    result_set_t::iterator found = resultSet.find(val);
-    if (found != resultSet.end()) {
-      return found->second;
-    }
-    if (isa<Constant>(val)) {
-      if (ConstantFP *CFP = dyn_cast<ConstantFP>(val)) {
-        // For constants, simulate conversion to fixed point
-        // and use the difference as a precision loss
-        const APFloat &val = CFP->getValueAPF();
-        double dval = val.convertToDouble();
-        uint64_t fixpoint = static_cast<uint64_t>(
-                              dval * static_cast<double>(1 << decimalBitWidth));
-        double converted = fixpoint / static_cast<double>(1 << decimalBitWidth);
-        return dval - converted;
-      }
-      llvm_unreachable("Analysing floating point precision of a non-floating-point constant!");
-      return -1;
+    if (const OptionalValue<double> *found = findResult(val)) {
+      return *found;
+    }
+    if (Constant *C = dyn_cast<Constant>(val)) {
+      return getConversionError(*C, formats.getFormat(C));
     } else {
-      // For variables, just assume a quantisation error for the current bit width
-      return getQuantError();
+      // For variables, just assume a quantisation error for their bit width
+      return getQuantError(val);
     }
   }
 
+  // Error of an operand once moved to another format
+  OptionalValue<double> getAlignedError(Value *val, int format) {
+    return getError(val) + getAlignmentError(formats.getFormat(val), format);
+  }
+
   OptionalValue<double> visitFAdd(BinaryOperator &B) {
     Value *op1 = B.getOperand(0);
     Value *op2 = B.getOperand(1);
-    OptionalValue<double> e1 = getError(op1);
-    OptionalValue<double> e2 = getError(op2);
-    return update(e1 + e2);
+    int common = getCommonFormat(formats.getFormat(op1), formats.getFormat(op2));
+    OptionalValue<double> e1 = getAlignedError(op1, common);
+    OptionalValue<double> e2 = getAlignedError(op2, common);
+    return update(B, e1 + e2 + getAlignmentError(common, formats.getFormat(&B)));
   }
 
   OptionalValue<double> visitFSub(BinaryOperator &B) {
     return visitFAdd(B);
   }
 
+  // The bits dropped from the operands, where the product would not fit
+  // even in a double word, add to their errors
+  OptionalValue<double> getProductError(Value *op1, Value *op2, int format,
+                                        OptionalValue<uint64_t> integerBits) {
+    int f1 = formats.getFormat(op1);
+    int f2 = formats.getFormat(op2);
+    ProductLowering lowering(f1, f2, integerBits);
+    OptionalValue<double> e1 = getAlignedError(op1, f1 - lowering.Shift1);
+    OptionalValue<double> e2 = getAlignedError(op2, f2 - lowering.Shift2);
+    return getRangeMax(op1) * e2 + getRangeMax(op2) * e1 + e1 * e2
+           + getAlignmentError(lowering.Fraction, format);
+  }
+
   OptionalValue<double> visitFMul(BinaryOperator &B) {
+    return update(B, getProductError(B.getOperand(0), B.getOperand(1), formats.getFormat(&B),
+                                     formats.getIntegerBits(&B)));
+  }
+
+  // A reciprocal has the error of its truncation and, computed at run time,
+  // the one of the divisor: err(1 / b) = err(b) / b^2. The quotient is then
+  // the product of the dividend by it.
+  OptionalValue<double> getReciprocalError(BinaryOperator &B,
+                                           const ReciprocalLowering &reciprocal) {
     Value *op1 = B.getOperand(0);
     Value *op2 = B.getOperand(1);
-    OptionalValue<double> e1 = getError(op1);
-    OptionalValue<double> e2 = getError(op2);
-    return update(getRangeMax(op1) * e2 + getRangeMax(op2)
-                  * e1 + e1 * e2 + getQuantError());
+    Range inverse = Range(1.0) / ranges.getRange(op2);
+    OptionalValue<double> inverseMax = fmax(fabs(inverse.getMin()), fabs(inverse.getMax()));
+    OptionalValue<double> er = ldexp(1.0, -reciprocal.Fraction);
+    if (!isa<Constant>(op2))
+      er = er + pow(inverseMax, 2) * getError(op2);
+    int f1 = formats.getFormat(op1);
+    ProductLowering lowering(f1, reciprocal.Fraction, formats.getIntegerBits(&B));
+    OptionalValue<double> e1 = getAlignedError(op1, f1 - lowering.Shift1);
+    er = er + getAlignmentError(reciprocal.Fraction, reciprocal.Fraction - lowering.Shift2);
+    return getRangeMax(op1) * er + inverseMax * e1 + e1 * er
+           + getAlignmentError(lowering.Fraction, formats.getFormat(&B));
   }
 
   OptionalValue<double> visitFDiv(BinaryOperator &B) {
+    ReciprocalLowering reciprocal;
+    if (formats.getReciprocalLowering(B, LI, reciprocal))
+      return update(B, getReciprocalError(B, reciprocal));
+    // Otherwise, the quotient is truncated to its own format, which may have
+    // less bits than the result
     Value *op1 = B.getOperand(0);
     Value *op2 = B.getOperand(1);
-    OptionalValue<double> e1 = getError(op1);
+    int f1 = formats.getFormat(op1);
+    QuotientLowering lowering(f1, formats.getFormat(op2), formats.getFormat(&B),
+                              formats.getIntegerBits(op1));
+    OptionalValue<double> e1 = getAlignedError(op1, f1 + lowering.Shift);
     OptionalValue<double> e2 = getError(op2);
-    return update(getRangeMax(op1) / pow(getRangeMax(op2), 2) * e2
-                  + 1.0 / getRangeMax(op2) * e1 + getQuantError());
+    return update(B, getRangeMax(op1) / pow(getRangeMax(op2), 2) * e2
+                  + 1.0 / getRangeMax(op2) * e1 + ldexp(1.0, -lowering.Fraction));
+  }
+
+  // The fixed point representation is not changed by the casts between
+  // floating point types, and represents the integers exactly
+  OptionalValue<double> visitCast(CastInst &C) {
+    if (C.getOpcode() == Instruction::FPExt || C.getOpcode() == Instruction::FPTrunc)
+      return update(C, getAlignedError(C.getOperand(0), formats.getFormat(&C)));
+    return update(C, 0.0);
+  }
+
+  // As for the branches, the errors of the condition are not considered
+  OptionalValue<double> visitSelect(SelectInst &S) {
+    int format = formats.getFormat(&S);
+    return update(S, max(getAlignedError(S.getTrueValue(), format),
+                         getAlignedError(S.getFalseValue(), format)));
+  }
+
+  // The errors of a vector are the ones of all its lanes
+  OptionalValue<double> visitLaneOperation(Instruction &I) {
+    int format = formats.getFormat(&I);
+    OptionalValue<double> res = 0.0;
+    for (User::op_iterator ops = I.op_begin(), opend = I.op_end(); ops != opend; ++ops) {
+      if (ops->get()->getType()->isFPOrFPVectorTy())
+        res = max(res, getAlignedError(ops->get(), format));
+    }
+    return update(I, res);
+  }
+
+  OptionalValue<double> visitMathCall(CallInst &call, MathFunction fn) {
+    Value *op1 = call.getArgOperand(0);
+    OptionalValue<double> e1 = getError(op1);
+    int format = formats.getFormat(&call);
+    switch (fn) {
+    case Fabs:
+      // ||x| - |y|| <= |x - y|
+      return update(call, getAlignedError(op1, format));
+    case Sqrt: {
+      // |sqrt(x) - sqrt(y)| <= sqrt(|x - y|), and about e / (2 sqrt(x))
+      // away from zero
+      if (!e1.isValid())
+        return update(call, e1);
+      OptionalValue<double> e = fabs(e1.get());
+      OptionalValue<double> err = pow(e, 0.5);
+      Range r = ranges.getRange(op1);
+      if (r.isValid() && r.getMin() > 0.0)
+        err = min(err, e / (2.0 * sqrt(r.getMin())));
+      return update(call, err + getQuantError(&call));
+    }
+    case FMulAdd: {
+      // The product gets the format of its own range, and is then added
+      Value *op2 = call.getArgOperand(1);
+      Value *op3 = call.getArgOperand(2);
+      OptionalValue<uint64_t> productBits = formats.getProductBits(op1, op2);
+      int product = formats.getProductFormat(op1, op2);
+      int common = getCommonFormat(product, formats.getFormat(op3));
+      return update(call, getProductError(op1, op2, product, productBits)
+                    + getAlignmentError(product, common) + getAlignedError(op3, common)
+                    + getAlignmentError(common, format));
+    }
+    default: {
+      // The operands are compared in the same format
+      Value *op2 = call.getArgOperand(1);
+      int common = getCommonFormat(formats.getFormat(op1), formats.getFormat(op2));
+      return update(call, max(getAlignedError(op1, common), getAlignedError(op2, common))
+                    + getAlignmentError(common, format));
+    }
+    }
+  }
+
+  // A load gives any of the values held by the object: the initial ones
+  // are constants, converted with a quantization error at most. The
+  // elements are held in the format of the object, so the values stored
+  // are aligned to it (the loads are visited again whenever a store is).
+  OptionalValue<double> visitLoad(LoadInst &L) {
+    unsigned idx = memory.lookup(&L);
+    const MemoryObjects::Object &object = memory.getObject(idx);
+    int format = formats.getObjectFormat(idx);
+    OptionalValue<double> res = object.Initial.isBottom() ? 0.0 : ldexp(1.0, -format);
+    for (std::vector<StoreInst *>::const_iterator it = object.Stores.begin(),
+         end = object.Stores.end(); it != end; ++it) {
+      if (const OptionalValue<double> *found = findResult(*it)) {
+        res = max(res, *found + getAlignmentError(formats.getFormat(*it), format));
+      }
+    }
+    return res + getAlignmentError(format, formats.getFormat(&L));
+  }
+
+  OptionalValue<double> visitStore(StoreInst &S) {
+    return getError(S.getValueOperand());
   }
 
   OptionalValue<double> visitPhi(PHINode &P) {
     OptionalValue<double> max = 0.0;
+    int format = formats.getFormat(&P);
     for (unsigned int i = 0; i < P.getNumOperands(); ++i) {
-      OptionalValue<double> e = getError(P.getOperand(i));
+      OptionalValue<double> e = getAlignedError(P.getOperand(i), format);
       if (e.isValid() && max.isValid() && e.get() > max.get())
         max = e;
     }
     return max;
   }
 };
+
+// Errors as affine forms centered in zero, run after
+// PrecisionAnalysisAlgorithm: the errors of the values sharing the same
+// inputs cancel out where the values do (e.g. in x - x, or in the taps of a
+// filter), each quantization introducing a noise symbol of its own. The
+// operands not visited yet take the error computed by the other algorithm,
+// and the phi nodes in the loop headers are decorrelated as in the range
+// analysis.
+class AffineErrorAlgorithm : public AnalysisAlgorithm<AffineErrorAlgorithm, AffineForm> {
+  friend class AnalysisAlgorithm<AffineErrorAlgorithm, AffineForm>;
+
+public:
+
+  AffineErrorAlgorithm(
+    LoopInfoBase<BasicBlock, Loop> &loopInfo,
+    const TripCounts &tripCounts,
+    const FunctionRanges &ranges,
+    AnalysisArena &arena,
+    const error_store_t &errors,
+    result_table_t &forms,
+    error_store_t &peaks) :
+    AnalysisAlgorithm<AffineErrorAlgorithm, AffineForm>(
+      loopInfo, tripCounts, ranges.Numbering, ranges.Memory, arena, forms),
+    LI(loopInfo),
+    ranges(ranges),
+    errors(errors),
+    peaks(peaks),
+    formats(ranges),
+    symbols(ranges.Numbering.size()) {
+  }
+
+  AffineForm getUnboundedResult() {
+    return AffineForm();
+  }
+
+  // As for PrecisionAnalysisAlgorithm, to the next power of two
+  AffineForm widen(const AffineForm &previous, const AffineForm &current) {
+    Range r = previous.getRange() | current.getRange();
+    if (r == previous.getRange())
+      return previous;
+    double exponent = ceil(log2(fmax(fabs(r.getMin()), fabs(r.getMax()))));
+    if (!r.isValid() || exponent > WORD_LENGTH)
+      return AffineForm();
+    double bound = ldexp(1.0, static_cast<int>(exponent));
+    return rescale(previous, Range(-bound, bound));
+  }
+
+  AffineForm narrow(const AffineForm &previous, const AffineForm &current) {
+    Range r = previous.getRange() & current.getRange();
+    return r == current.getRange() ? current : rescale(current, r);
+  }
+
+  static OptionalValue<double> getMagnitude(const AffineForm &form) {
+    Range r = form.getRange();
+    if (r.isBottom())
+      return 0.0;
+    if (!r.isValid())
+      return OptionalValue<double>::invalid();
+    return OptionalValue<double>(fmax(fabs(r.getMin()), fabs(r.getMax())));
+  }
+
+private:
+  LoopInfoBase<BasicBlock, Loop> &LI;
+  const FunctionRanges &ranges;
+  const error_store_t &errors;
+  error_store_t &peaks;
+  FixedPointFormats formats;
+  NoiseSymbols symbols;
+
+  AffineForm update(Instruction &I, const AffineForm &form) {
+    unsigned idx = numbering.lookup(&I);
+    OptionalValue<double> val = getMagnitude(form);
+    peaks.set(idx, peaks.has(idx) ? max(val, peaks.get(idx)) : val);
+    return form;
+  }
+
+  AffineForm rescale(const AffineForm &form, const Range &r) {
+    unsigned symbol = form.getNumTerms() > 0 ? form.getSymbol(0) : symbols.fresh();
+    return AffineForm::fromRange(r, symbol, &symbols);
+  }
+
+  // Form of a quantity in the range, independent of the others
+  AffineForm getIndependent(const Range &r) {
+    return AffineForm::fromRange(r, symbols.fresh(), &symbols);
+  }
+
+  // Error of a truncation to the format, or of a shift from a format to
+  // another, independent of the others
+  AffineForm getQuantError(int format) {
+    double q = ldexp(1.0, -format);
+    return getIndependent(Range(-q, q));
+  }
+
+  AffineForm getAlignmentForm(int from, int to) {
+    double q = getAlignmentError(from, to);
+    return q > 0.0 ? getIndependent(Range(-q, q)) : AffineForm(0.0);
+  }
+
+  // Error of a value depending on its own noise symbol
+  AffineForm getErrorOf(unsigned idx, OptionalValue<double> error) {
+    if (!error.isValid())
+      return AffineForm();
+    double e = fabs(error.get());
+    return AffineForm::fromRange(Range(-e, e), idx, &symbols);
+  }
+
+  AffineForm getError(Value *val) {
+    if (const AffineForm *found = findResult(val)) {
+      return *found;
+    }
+    if (ConstantFP *CFP = dyn_cast<ConstantFP>(val)) {
+      return AffineForm(getConversionError(*CFP, formats.getFormat(CFP)));
+    }
+    // The lanes of a vector constant have different errors
+    if (Constant *C = dyn_cast<Constant>(val)) {
+      double e = getConversionError(*C, formats.getFormat(C));
+      return e > 0.0 ? getIndependent(Range(-e, e)) : AffineForm(0.0);
+    }
+    unsigned idx = numbering.lookup(val);
+    if (idx == ValueNumbering::NotNumbered) {
+      return getQuantError(formats.getFormat(val));
+    }
+    if (errors.has(idx)) {
+      return getErrorOf(idx, errors.get(idx));
+    }
+    // As in PrecisionAnalysisAlgorithm, a quantization error for the variables
+    return getErrorOf(idx, ldexp(1.0, -formats.getFormat(val)));
+  }
+
+  // As in PrecisionAnalysisAlgorithm, the shifts between the formats add to
+  // the errors of the operands
+  AffineForm getAlignedError(Value *val, int format) {
+    return getError(val) + getAlignmentForm(formats.getFormat(val), format);
+  }
+
+  AffineForm visitFAdd(BinaryOperator &B) {
+    Value *op1 = B.getOperand(0);
+    Value *op2 = B.getOperand(1);
+    int common = getCommonFormat(formats.getFormat(op1), formats.getFormat(op2));
+    return update(B, getAlignedError(op1, common) + getAlignedError(op2, common)
+                  + getAlignmentForm(common, formats.getFormat(&B)));
+  }
+
+  AffineForm visitFSub(BinaryOperator &B) {
+    Value *op1 = B.getOperand(0);
+    Value *op2 = B.getOperand(1);
+    int common = getCommonFormat(formats.getFormat(op1), formats.getFormat(op2));
+    return update(B, getAlignedError(op1, common) - getAlignedError(op2, common)
+                  + getAlignmentForm(common, formats.getFormat(&B)));
+  }
+
+  // err(a b) = a err(b) + b err(a) + err(a) err(b) + q
+  AffineForm getProductError(Value *op1, Value *op2, int format,
+                             OptionalValue<uint64_t> integerBits) {
+    int f1 = formats.getFormat(op1);
+    int f2 = formats.getFormat(op2);
+    ProductLowering lowering(f1, f2, integerBits);
+    AffineForm e1 = getAlignedError(op1, f1 - lowering.Shift1);
+    AffineForm e2 = getAlignedError(op2, f2 - lowering.Shift2);
+    AffineForm r1 = getIndependent(ranges.getRange(op1));
+    AffineForm r2 = getIndependent(ranges.getRange(op2));
+    return r1 * e2 + r2 * e1 + e1 * e2 + getAlignmentForm(lowering.Fraction, format);
+  }
+
+  AffineForm visitFMul(BinaryOperator &B) {
+    return update(B, getProductError(B.getOperand(0), B.getOperand(1), formats.getFormat(&B),
+                                     formats.getIntegerBits(&B)));
+  }
+
+  // As in PrecisionAnalysisAlgorithm, err(a r) with the reciprocal
+  // r = 1 / b, whose error is err(r) = -err(b) / b^2 + q
+  AffineForm getReciprocalError(BinaryOperator &B, const ReciprocalLowering &reciprocal) {
+    Value *op1 = B.getOperand(0);
+    Value *op2 = B.getOperand(1);
+    Range inverse = Range(1.0) / ranges.getRange(op2);
+    AffineForm er = getQuantError(reciprocal.Fraction);
+    if (!isa<Constant>(op2))
+      er = er - getError(op2) * getIndependent(inverse * inverse);
+    int f1 = formats.getFormat(op1);
+    ProductLowering lowering(f1, reciprocal.Fraction, formats.getIntegerBits(&B));
+    AffineForm e1 = getAlignedError(op1, f1 - lowering.Shift1);
+    er = er + getAlignmentForm(reciprocal.Fraction, reciprocal.Fraction - lowering.Shift2);
+    AffineForm r1 = getIndependent(ranges.getRange(op1));
+    return r1 * er + getIndependent(inverse) * e1 + e1 * er
+           + getAlignmentForm(lowering.Fraction, formats.getFormat(&B));
+  }
+
+  // err(a / b) = err(a) / b - a err(b) / b^2 + q
+  AffineForm visitFDiv(BinaryOperator &B) {
+    ReciprocalLowering reciprocal;
+    if (formats.getReciprocalLowering(B, LI, reciprocal))
+      return update(B, getReciprocalError(B, reciprocal));
+    Value *op1 = B.getOperand(0);
+    Value *op2 = B.getOperand(1);
+    int f1 = formats.getFormat(op1);
+    QuotientLowering lowering(f1, formats.getFormat(op2), formats.getFormat(&B),
+                              formats.getIntegerBits(op1));
+    AffineForm e1 = getAlignedError(op1, f1 + lowering.Shift);
+    AffineForm e2 = getError(op2);
+    Range r1 = ranges.getRange(op1);
+    Range r2 = ranges.getRange(op2);
+    AffineForm inverse = getIndependent(Range(1.0) / r2);
+    AffineForm scale = getIndependent(r1 / (r2 * r2));
+    return update(B, e1 * inverse - e2 * scale + getQuantError(lowering.Fraction));
+  }
+
+  AffineForm visitCast(CastInst &C) {
+    if (C.getOpcode() == Instruction::FPExt || C.getOpcode() == Instruction::FPTrunc)
+      return update(C, getAlignedError(C.getOperand(0), formats.getFormat(&C)));
+    return update(C, AffineForm(0.0));
+  }
+
+  AffineForm visitSelect(SelectInst &S) {
+    int format = formats.getFormat(&S);
+    return update(S, getAlignedError(S.getTrueValue(), format)
+                  | getAlignedError(S.getFalseValue(), format));
+  }
+
+  // The noise symbols of a vector are correlated only with the same lanes
+  // of the other values, so the lanes moved elsewhere take the error
+  // computed by PrecisionAnalysisAlgorithm, as the loads
+  AffineForm visitLaneOperation(Instruction &I) {
+    unsigned idx = numbering.lookup(&I);
+    if (!errors.has(idx))
+      return update(I, AffineForm());
+    return update(I, getErrorOf(idx, errors.get(idx)));
+  }
+
+  // The errors of fabs and sqrt are the ones computed by
+  // PrecisionAnalysisAlgorithm, depending on a noise symbol of their own
+  AffineForm visitMathCall(CallInst &call, MathFunction fn) {
+    Value *op1 = call.getArgOperand(0);
+    switch (fn) {
+    case FMulAdd: {
+      Value *op2 = call.getArgOperand(1);
+      Value *op3 = call.getArgOperand(2);
+      OptionalValue<uint64_t> productBits = formats.getProductBits(op1, op2);
+      int product = formats.getProductFormat(op1, op2);
+      int common = getCommonFormat(product, formats.getFormat(op3));
+      return update(call, getProductError(op1, op2, product, productBits)
+                    + getAlignmentForm(product, common) + getAlignedError(op3, common)
+                    + getAlignmentForm(common, formats.getFormat(&call)));
+    }
+    case FMin:
+    case FMax: {
+      Value *op2 = call.getArgOperand(1);
+      int common = getCommonFormat(formats.getFormat(op1), formats.getFormat(op2));
+      return update(call, (getAlignedError(op1, common) | getAlignedError(op2, common))
+                    + getAlignmentForm(common, formats.getFormat(&call)));
+    }
+    default: {
+      unsigned idx = numbering.lookup(&call);
+      if (!errors.has(idx))
+        return update(call, AffineForm());
+      return update(call, getErrorOf(idx, errors.get(idx)));
+    }
+    }
+  }
+
+  // The elements of an object do not share their noise symbols, so a load
+  // takes the error computed by PrecisionAnalysisAlgorithm
+  AffineForm visitLoad(LoadInst &L) {
+    unsigned idx = numbering.lookup(&L);
+    if (!errors.has(idx))
+      return AffineForm();
+    return getErrorOf(idx, errors.get(idx));
+  }
+
+  AffineForm visitStore(StoreInst &S) {
+    return getError(S.getValueOperand());
+  }
+
+  AffineForm visitPhi(PHINode &P) {
+    int format = formats.getFormat(&P);
+    if (LI.isLoopHeader(P.getParent())) {
+      Range r = Range::Bottom();
+      for (unsigned int i = 0; i < P.getNumOperands(); ++i)
+        r = r | getAlignedError(P.getOperand(i), format).getRange();
+      return AffineForm::fromRange(r, numbering.lookup(&P), &symbols);
+    }
+    AffineForm res = getAlignedError(P.getOperand(0), format);
+    for (unsigned int i = 1; i < P.getNumOperands(); ++i)
+      res = res | getAlignedError(P.getOperand(i), format);
+    return res;
+  }
+};
 }
 
-bool PrecisionAnalysis::runOnFunction(Function &F) {
-  FloatRangeAnalysis &FRA = getAnalysis<FloatRangeAnalysis>();
-  LoopInfo &LI = getAnalysis<LoopInfo>();
-  ScalarEvolution &scev = getAnalysis<ScalarEvolution>();
+// Both errors are sound bounds, so each value gets the smallest one
+static void refineErrors(Function &F,
+                         LoopInfoBase<BasicBlock, Loop> &LI,
+                         const TripCounts &TC,
+                         const FunctionRanges &ranges,
+                         const BitVector *slice,
+                         AnalysisArena &arena,
+                         FunctionErrors &result) {
+  unsigned size = ranges.Numbering.size();
+  ResultTable<AffineForm> forms;
+  forms.reset(size, AffineForm());
+  error_store_t peaks;
+  peaks.reset(size, OptionalValue<double>::invalid());
+
+  AffineErrorAlgorithm algorithm(LI, TC, ranges, arena, result.Errors, forms, peaks);
+  if (slice == NULL) {
+    algorithm.analyze(F);
+  } else {
+    algorithm.analyze(F, *slice);
+  }
+  NumErrorVisits += algorithm.getNumVisits();
+
+  for (unsigned idx = 0; idx < size; ++idx) {
+    if (forms.has(idx) && result.Errors.has(idx)) {
+      result.Errors.set(idx, min(result.Errors.get(idx),
+                                 AffineErrorAlgorithm::getMagnitude(forms.get(idx))));
+    }
+    if (peaks.has(idx) && result.Peaks.has(idx)) {
+      result.Peaks.set(idx, min(result.Peaks.get(idx), peaks.get(idx)));
+    }
+  }
+}
+
+// The maximum error is the largest one computed during the analysis
+static OptionalValue<double> computeMaxError(const error_store_t &peaks) {
+  OptionalValue<double> res(0.0);
+  for (unsigned idx = 0; idx < peaks.size() && res.isValid(); ++idx) {
+    if (peaks.has(idx)) {
+      res = max(peaks.get(idx), res);
+    }
+  }
+  return res;
+}
+
+void PrecisionAnalysis::computeErrors(Function &F,
+                                      LoopInfoBase<BasicBlock, Loop> &LI,
+                                      const TripCounts &TC,
+                                      const FunctionRanges &ranges,
+                                      FunctionErrors &result,
+                                      AnalysisArena *arena) {
+  AnalysisArena localArena;
+  if (arena == NULL) {
+    arena = &localArena;
+  }
+  arena->reset();
+
+  result.DecimalBitWidth = computeInternalDBW(ranges.MinimumBits);
+  result.RangesGeneration = ranges.Generation;
 
-  uint64_t decimalBitWidth = getInternalDBW(F);
+  result.Errors.reset(ranges.Numbering.size(), OptionalValue<double>::invalid());
+  result.Peaks.reset(ranges.Numbering.size(), OptionalValue<double>::invalid());
 
-  PrecisionAnalysisAlgorithm algorithm(LI, scev, FRA, decimalBitWidth);
+  // The algorithm writes its results directly into the tables
+  PrecisionAnalysisAlgorithm algorithm(LI, TC, ranges, *arena, result.Errors, result.Peaks);
 
-  algorithm.analyze(inst_begin(F), inst_end(F));
+  algorithm.analyze(F);
+  NumErrorInstructions += algorithm.getNumInstructions();
+  NumErrorVisits += algorithm.getNumVisits();
 
-  maxErrors.insert(std::make_pair<Function *, OptionalValue<double> >(
-                     &F,
-                     algorithm.getMaxError()));
+  if (getRangeDomain() == AffineDomain)
+    refineErrors(F, LI, TC, ranges, NULL, *arena, result);
 
-  PrecisionAnalysisAlgorithm::result_set_t res = algorithm.getResult();
-  for (PrecisionAnalysisAlgorithm::result_set_t::iterator el = res.begin(),
-       end = res.end(); el != end; ++el) {
-    errorMap.insert(*el);
+  result.MaxError = computeMaxError(result.Peaks);
+}
+
+void PrecisionAnalysis::updateErrors(Function &F,
+                                     LoopInfoBase<BasicBlock, Loop> &LI,
+                                     const TripCounts &TC,
+                                     const FunctionRanges &ranges,
+                                     FunctionErrors &result,
+                                     AnalysisArena *arena) {
+  // The format of each value only depends on its own range, but the tables
+  // can only be kept as long as the numbering does not change
+  if (ranges.Renumbered || result.RangesGeneration + 1 != ranges.Generation
+      || result.Errors.size() != ranges.Numbering.size()) {
+    computeErrors(F, LI, TC, ranges, result, arena);
+    return;
+  }
+  AnalysisArena localArena;
+  if (arena == NULL) {
+    arena = &localArena;
   }
+  arena->reset();
+
+  result.DecimalBitWidth = computeInternalDBW(ranges.MinimumBits);
+  result.RangesGeneration = ranges.Generation;
+  const BitVector &slice = ranges.Updated;
+  for (int idx = slice.find_first(); idx >= 0; idx = slice.find_next(idx)) {
+    result.Errors.unset(idx);
+    result.Peaks.unset(idx);
+  }
+
+  PrecisionAnalysisAlgorithm algorithm(LI, TC, ranges, *arena, result.Errors, result.Peaks);
+
+  algorithm.analyze(F, slice);
+  NumErrorInstructions += algorithm.getNumInstructions();
+  NumErrorVisits += algorithm.getNumVisits();
+
+  if (getRangeDomain() == AffineDomain)
+    refineErrors(F, LI, TC, ranges, &slice, *arena, result);
+
+  result.MaxError = computeMaxError(result.Peaks);
+}
+
+static bool loadFromCache(const FunctionRanges &ranges, FunctionErrors &result) {
+  FunctionErrors cached;
+  if (!ResultCache::loadErrors(ranges.CacheKey, ranges.Numbering.size(), cached)
+      || cached.DecimalBitWidth != PrecisionAnalysis::computeInternalDBW(ranges.MinimumBits))
+    return false;
+  cached.RangesGeneration = ranges.Generation;
+  result.swap(cached);
+  return true;
+}
+
+// The ranges updated from the cached ones of a previous version of the
+// function are followed by its cached errors, which are then updated as well
+static void loadPreviousFromCache(const FunctionRanges &ranges, FunctionErrors &result) {
+  FunctionErrors cached;
+  if (ranges.Renumbered
+      || !ResultCache::loadErrors(ranges.PreviousKey, ranges.Numbering.size(), cached)
+      || cached.DecimalBitWidth != PrecisionAnalysis::computeInternalDBW(ranges.MinimumBits))
+    return;
+  cached.RangesGeneration = ranges.Generation - 1;
+  result.swap(cached);
+}
+
+bool PrecisionAnalysis::runOnFunction(Function &F) {
+  FloatRangeAnalysis &FRA = getAnalysis<FloatRangeAnalysis>();
+  Errors = &Results[&F];
+
+  // Adopt the results of the module-level driver, if it already ran
+  ParallelAnalysisDriver *Driver = getAnalysisIfAvailable<ParallelAnalysisDriver>();
+  if (Driver == NULL || !Driver->takeErrors(F, *Errors)) {
+    LoopInfo &LI = getAnalysis<LoopInfo>();
+    ScalarEvolution &scev = getAnalysis<ScalarEvolution>();
+    TripCounts TC;
+    TC.compute(LI, scev);
+    const FunctionRanges &ranges = FRA.getRanges();
+    // Cached errors are only valid for the cached ranges they were computed from
+    if (ranges.CacheKey == 0 || !loadFromCache(ranges, *Errors)) {
+      if (ranges.PreviousKey != 0 && Errors->Errors.size() == 0)
+        loadPreviousFromCache(ranges, *Errors);
+      updateErrors(F, LI.getBase(), TC, ranges, *Errors, &Arena);
+      if (ranges.CacheKey != 0)
+        ResultCache::storeErrors(ranges.CacheKey, *Errors);
+    }
+  }
+
+  // OptionalValue has no default constructor, so operator[] cannot be used
+  maxErrors.erase(&F);
+  maxErrors.insert(std::make_pair(&F, Errors->MaxError));
 
   DEBUG(printAll(F));
 
   return false; /* analysis pass */
 }
 
+void PrecisionAnalysis::releaseMemory() {
+  Results.clear();
+  maxErrors.clear();
+  Errors = NULL;
+  Arena.reset();
+}
+
 OptionalValue<double> PrecisionAnalysis::getMaximumError(const Function &F) const {
   std::map<const Function *, OptionalValue<double> >::const_iterator found = maxErrors.find(&F);
   if (found != maxErrors.end()) {
@@ -187,8 +803,7 @@ uint64_t PrecisionAnalysis::getInternalDBW(const Function &F) const {
   FloatRangeAnalysis &FRA = getAnalysis<FloatRangeAnalysis>();
 
   OptionalValue<uint64_t> integerBitWidth = FRA.getMinimumIntegerBitWidth(F);
-  uint64_t decimalBitWidth = integerBitWidth.isValid() ?
-                             (WORD_LENGTH - integerBitWidth.get()) / 2 : 0;
+  uint64_t decimalBitWidth = computeInternalDBW(integerBitWidth);
 
   DEBUG(errs() << "Integer BW: " << integerBitWidth
         << " ; Decimal BW : " << decimalBitWidth << "\n");
@@ -196,13 +811,18 @@ uint64_t PrecisionAnalysis::getInternalDBW(const Function &F) const {
   return decimalBitWidth;
 }
 
+uint64_t PrecisionAnalysis::computeInternalDBW(OptionalValue<uint64_t> integerBitWidth) {
+  return getFractionalBits(integerBitWidth);
+}
+
 void PrecisionAnalysis::printAll(const Function &F) const {
+  FloatRangeAnalysis &FRA = getAnalysis<FloatRangeAnalysis>();
   errs() << "Printing precision for the function " << F.getName() << "\n\n";
   for (const_inst_iterator BI = inst_begin(F), BE = inst_end(F); BI != BE; ++BI) {
     const Value *I = &(*BI);
-    std::map<const Value *, OptionalValue<double> >::const_iterator res = errorMap.find(I);
-    if (res != errorMap.end()) {
-      errs() << res->second;
+    unsigned idx = FRA.getNumbering().lookup(I);
+    if (Errors->Errors.has(idx)) {
+      errs() << Errors->Errors.get(idx);
     }
     I->print(errs());
     errs() << '\n';
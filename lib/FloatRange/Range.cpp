@@ -1,104 +1,85 @@
 #include "Range.h"
 
 #include <iostream>
+#include <algorithm>
 #include <cmath>
 
 using namespace cto;
 
-Range Range::Top;
+const Range Range::Top;
 
-Range Range::operator+(const Range &rhs) {
-  if (bottom || rhs.bottom)
-    return Bottom();
-  if (valid && rhs.valid) {
-    Range r(min, max);
-    r.min += rhs.min;
-    r.max += rhs.max;
-    return r;
-  } else {
-    return Range::Top;
-  }
+// The infinities and the not-a-number bounds produced by the arithmetic on
+// Top are normalized by the constructor; only Bottom needs to be checked.
+
+Range Range::operator+(const Range &rhs) const {
+  Range r(min + rhs.min, max + rhs.max);
+  return isBottom() || rhs.isBottom() ? Bottom() : r;
 }
 
-Range Range::operator-(const Range &rhs) {
-  if (bottom || rhs.bottom)
-    return Bottom();
-  if (valid && rhs.valid) {
-    double a = this->min - rhs.min;
-    double b = this->max - rhs.max;
-    Range r(fmin(a, b), fmax(a, b));
-    return r;
-  } else {
-    return Range::Top;
-  }
+Range Range::operator-(const Range &rhs) const {
+  Range r(min - rhs.max, max - rhs.min);
+  return isBottom() || rhs.isBottom() ? Bottom() : r;
 }
 
-Range Range::operator*(const Range &rhs) {
-  if (bottom || rhs.bottom)
-    return Bottom();
-  if (valid && rhs.valid) {
-    Range r(min, max);
-    r.min = fmin(
-              fmin(min * rhs.min, max * rhs.min),
-              fmin(min * rhs.max, max * rhs.max));
-    r.max = fmax(
-              fmax(min * rhs.min, max * rhs.min),
-              fmax(min * rhs.max, max * rhs.max));
-    return r;
-  } else {
-    return Range::Top;
-  }
+Range Range::operator*(const Range &rhs) const {
+  double ac = min * rhs.min;
+  double bc = max * rhs.min;
+  double ad = min * rhs.max;
+  double bd = max * rhs.max;
+  Range r(fmin(fmin(ac, bc), fmin(ad, bd)), fmax(fmax(ac, bc), fmax(ad, bd)));
+  return isBottom() || rhs.isBottom() ? Bottom() : r;
 }
 
-Range Range::operator/(const Range &rhs) {
-  if (bottom || rhs.bottom)
-    return Bottom();
-  if (valid && rhs.valid) {
-    Range r(min, max);
-    r.min = fmin(
-              fmin(min / rhs.min, max / rhs.min),
-              fmin(min / rhs.max, max / rhs.max));
-    r.max = fmax(
-              fmax(min / rhs.min, max / rhs.min),
-              fmax(min / rhs.max, max / rhs.max));
-    return r;
-  } else {
-    return Range::Top;
-  }
+Range Range::operator/(const Range &rhs) const {
+  double ac = min / rhs.min;
+  double bc = max / rhs.min;
+  double ad = min / rhs.max;
+  double bd = max / rhs.max;
+  Range r(fmin(fmin(ac, bc), fmin(ad, bd)), fmax(fmax(ac, bc), fmax(ad, bd)));
+  // The quotient is unbounded near zero, and the bounds above do not see it
+  r = rhs.contains(0.0) ? Top : r;
+  return isBottom() || rhs.isBottom() ? Bottom() : r;
 }
 
-Range Range::operator|(const Range &rhs) {
-  if (bottom)
-    return rhs;
-  if (rhs.bottom)
+// As Bottom is [+inf, -inf], it is the identity of the union
+Range Range::operator|(const Range &rhs) const {
+  return Range(fmin(min, rhs.min), fmax(max, rhs.max));
+}
+
+// Disjoint ranges give min > max, i.e. Bottom
+Range Range::operator&(const Range &rhs) const {
+  return Range(fmax(min, rhs.min), fmin(max, rhs.max));
+}
+
+Range Range::widen(const Range &next, const std::vector<double> &thresholds) const {
+  if (isBottom())
+    return next;
+  if (next.isBottom())
     return *this;
-  if (valid && rhs.valid) {
-    Range r(min, max);
-    r.min = fmin(min, rhs.min);
-    r.max = fmax(max, rhs.max);
-    return r;
-  } else {
+  if (!isValid() || !next.isValid())
     return Range::Top;
+
+  double wmin = min;
+  if (next.min < min) {
+    // largest threshold not greater than the new lower bound
+    std::vector<double>::const_iterator it =
+      std::upper_bound(thresholds.begin(), thresholds.end(), next.min);
+    if (it == thresholds.begin())
+      return Range::Top;
+    wmin = *(--it);
   }
-}
 
-Range Range::operator&(const Range &rhs) {
-  if (bottom || rhs.bottom)
-    return Bottom();
-  if (valid && rhs.valid) {
-    Range r(min, max);
-    if (max < rhs. min || min > rhs.max)
-      return Bottom(); // intersection of overlapping ranges
-    r.min = fmax(min, rhs.min);
-    r.max = fmin(max, rhs.max);
-    return r;
-  } else {
-    if (valid) return *this;
-    if (rhs.valid) return rhs;
-    if (bottom && rhs.bottom)
-      return Bottom();
-    return Range::Top;
+  double wmax = max;
+  if (next.max > max) {
+    // smallest threshold not lower than the new upper bound
+    std::vector<double>::const_iterator it =
+      std::lower_bound(thresholds.begin(), thresholds.end(), next.max);
+    if (it == thresholds.end())
+      return Range::Top;
+    wmax = *it;
   }
+
+  return Range(wmin, wmax);
 }
 
 // Note: this implements floating point comparison with ==, so it should be
@@ -106,21 +87,21 @@ Range Range::operator&(const Range &rhs) {
 // namely to understand whether two ranges are both valid \ not valid)
 
 bool Range::operator==(const Range &rhs) const {
-  if (this->valid != rhs.valid)
-    return false;
-  if (!this->valid && !rhs.valid)
-    return true;
-  if (this->bottom && rhs.bottom)
-    return true;
   return this->min == rhs.min && this->max == rhs.max;
 }
 
+bool Range::operator<(const Range &rhs) const {
+  if (this->min != rhs.min)
+    return this->min < rhs.min;
+  return this->max < rhs.max;
+}
+
 namespace cto {
 
 std::ostream &operator<<(std::ostream &os, const Range &obj) {
-  if (obj.valid) {
+  if (obj.isValid()) {
     os << '[' << obj.min << ", " << obj.max << ']';
-  } else if (obj.bottom) {
+  } else if (obj.isBottom()) {
     os << "[Bottom]";
   } else {
     os << "[Top]";
@@ -129,9 +110,9 @@ std::ostream &operator<<(std::ostream &os, const Range &obj) {
 }
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const Range &obj) {
-  if (obj.valid) {
+  if (obj.isValid()) {
     os << '[' << obj.min << ", " << obj.max << ']';
-  } else if (obj.bottom) {
+  } else if (obj.isBottom()) {
     os << "[Bottom]";
   } else {
     os << "[Top]";
@@ -0,0 +1,228 @@
+#include "RangeBatch.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define HAVE_VECTOR_KERNELS
+typedef __m256d vector_t;
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_VECTOR_KERNELS
+typedef __m128d vector_t;
+#endif
+
+using namespace cto;
+
+namespace {
+
+// The kernels are written once against these overloads, and instantiated
+// for the vector type and for the scalar remainder. min and max ignore a NaN
+// operand as fmin and fmax do, as the scalar operators rely on them.
+
+inline double load(const double *p, double) {
+  return *p;
+}
+inline void store(double *p, double v) {
+  *p = v;
+}
+inline double add(double a, double b) {
+  return a + b;
+}
+inline double sub(double a, double b) {
+  return a - b;
+}
+inline double mul(double a, double b) {
+  return a * b;
+}
+inline double div(double a, double b) {
+  return a / b;
+}
+inline double min(double a, double b) {
+  return ::fmin(a, b);
+}
+inline double max(double a, double b) {
+  return ::fmax(a, b);
+}
+
+#if defined(__AVX__)
+inline vector_t load(const double *p, vector_t) {
+  return _mm256_loadu_pd(p);
+}
+inline void store(double *p, vector_t v) {
+  _mm256_storeu_pd(p, v);
+}
+inline vector_t add(vector_t a, vector_t b) {
+  return _mm256_add_pd(a, b);
+}
+inline vector_t sub(vector_t a, vector_t b) {
+  return _mm256_sub_pd(a, b);
+}
+inline vector_t mul(vector_t a, vector_t b) {
+  return _mm256_mul_pd(a, b);
+}
+inline vector_t div(vector_t a, vector_t b) {
+  return _mm256_div_pd(a, b);
+}
+// minpd returns the second operand if either is NaN
+inline vector_t min(vector_t a, vector_t b) {
+  return _mm256_blendv_pd(_mm256_min_pd(a, b), a, _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+}
+inline vector_t max(vector_t a, vector_t b) {
+  return _mm256_blendv_pd(_mm256_max_pd(a, b), a, _mm256_cmp_pd(b, b, _CMP_UNORD_Q));
+}
+#elif defined(__SSE2__)
+inline vector_t load(const double *p, vector_t) {
+  return _mm_loadu_pd(p);
+}
+inline void store(double *p, vector_t v) {
+  _mm_storeu_pd(p, v);
+}
+inline vector_t add(vector_t a, vector_t b) {
+  return _mm_add_pd(a, b);
+}
+inline vector_t sub(vector_t a, vector_t b) {
+  return _mm_sub_pd(a, b);
+}
+inline vector_t mul(vector_t a, vector_t b) {
+  return _mm_mul_pd(a, b);
+}
+inline vector_t div(vector_t a, vector_t b) {
+  return _mm_div_pd(a, b);
+}
+// minpd returns the second operand if either is NaN
+inline vector_t select(vector_t mask, vector_t a, vector_t b) {
+  return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+inline vector_t min(vector_t a, vector_t b) {
+  return select(_mm_cmpunord_pd(b, b), a, _mm_min_pd(a, b));
+}
+inline vector_t max(vector_t a, vector_t b) {
+  return select(_mm_cmpunord_pd(b, b), a, _mm_max_pd(a, b));
+}
+#endif
+
+// [a, b] op [c, d] = [lo, hi], as computed by the operators of Range
+
+struct AddKernel {
+  template <typename V>
+  static void compute(V a, V b, V c, V d, V &lo, V &hi) {
+    lo = add(a, c);
+    hi = add(b, d);
+  }
+};
+
+struct SubKernel {
+  template <typename V>
+  static void compute(V a, V b, V c, V d, V &lo, V &hi) {
+    lo = sub(a, d);
+    hi = sub(b, c);
+  }
+};
+
+struct MulKernel {
+  template <typename V>
+  static void compute(V a, V b, V c, V d, V &lo, V &hi) {
+    V ac = mul(a, c);
+    V bc = mul(b, c);
+    V ad = mul(a, d);
+    V bd = mul(b, d);
+    lo = min(min(ac, bc), min(ad, bd));
+    hi = max(max(ac, bc), max(ad, bd));
+  }
+};
+
+struct DivKernel {
+  template <typename V>
+  static void compute(V a, V b, V c, V d, V &lo, V &hi) {
+    V ac = div(a, c);
+    V bc = div(b, c);
+    V ad = div(a, d);
+    V bd = div(b, d);
+    lo = min(min(ac, bc), min(ad, bd));
+    hi = max(max(ac, bc), max(ad, bd));
+  }
+};
+
+struct JoinKernel {
+  template <typename V>
+  static void compute(V a, V b, V c, V d, V &lo, V &hi) {
+    lo = min(a, c);
+    hi = max(b, d);
+  }
+};
+
+// Disjoint ranges give lo > hi, i.e. Bottom once converted to a Range
+struct MeetKernel {
+  template <typename V>
+  static void compute(V a, V b, V c, V d, V &lo, V &hi) {
+    lo = max(a, c);
+    hi = min(b, d);
+  }
+};
+
+// Evaluate the kernel from begin on, as long as a whole V fits, and return
+// the first index left
+template <typename V, typename Kernel>
+unsigned apply(unsigned begin, unsigned n,
+               const double *lhsMin, const double *lhsMax,
+               const double *rhsMin, const double *rhsMax,
+               double *resMin, double *resMax) {
+  const unsigned width = sizeof(V) / sizeof(double);
+  unsigned i = begin;
+  for (; i + width <= n; i += width) {
+    V lo, hi;
+    Kernel::compute(load(lhsMin + i, V()), load(lhsMax + i, V()),
+                    load(rhsMin + i, V()), load(rhsMax + i, V()), lo, hi);
+    store(resMin + i, lo);
+    store(resMax + i, hi);
+  }
+  return i;
+}
+
+template <typename Kernel>
+void run(unsigned n,
+         const double *lhsMin, const double *lhsMax,
+         const double *rhsMin, const double *rhsMax,
+         double *resMin, double *resMax) {
+  unsigned i = 0;
+#ifdef HAVE_VECTOR_KERNELS
+  i = apply<vector_t, Kernel>(i, n, lhsMin, lhsMax, rhsMin, rhsMax, resMin, resMax);
+#endif
+  apply<double, Kernel>(i, n, lhsMin, lhsMax, rhsMin, rhsMax, resMin, resMax);
+}
+
+}
+
+void RangeBatch::evaluate(Operation op) {
+  unsigned n = size();
+  resMin.resize(n);
+  resMax.resize(n);
+  if (n == 0)
+    return;
+
+  const double *a = &lhsMin[0];
+  const double *b = &lhsMax[0];
+  const double *c = &rhsMin[0];
+  const double *d = &rhsMax[0];
+  switch (op) {
+  case Add:
+    run<AddKernel>(n, a, b, c, d, &resMin[0], &resMax[0]);
+    break;
+  case Sub:
+    run<SubKernel>(n, a, b, c, d, &resMin[0], &resMax[0]);
+    break;
+  case Mul:
+    run<MulKernel>(n, a, b, c, d, &resMin[0], &resMax[0]);
+    break;
+  case Div:
+    run<DivKernel>(n, a, b, c, d, &resMin[0], &resMax[0]);
+    break;
+  case Join:
+    run<JoinKernel>(n, a, b, c, d, &resMin[0], &resMax[0]);
+    break;
+  case Meet:
+    run<MeetKernel>(n, a, b, c, d, &resMin[0], &resMax[0]);
+    break;
+  }
+}
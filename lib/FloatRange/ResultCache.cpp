@@ -0,0 +1,532 @@
+#define DEBUG_TYPE "float-range-cache"
+
+#include "ResultCache.h"
+#include "AnalysisAlgorithm.h"
+#include "FixedPointFormat.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace cto;
+using namespace llvm;
+
+STATISTIC(NumCacheHits, "Number of analysis results loaded from the cache");
+STATISTIC(NumCacheMisses, "Number of analysis results not found in the cache");
+
+static cl::opt<std::string> CacheDir("float-range-cache", cl::init(""),
+    cl::desc("Directory where the results of the range and precision "
+             "analyses are cached across runs (disabled if empty)."));
+
+// To be changed whenever the format or the analyses change, so that the
+// results cached by previous versions are not used
+#define CACHE_VERSION 8
+#define RANGES_MAGIC (0x5346525243000000ULL | CACHE_VERSION)
+#define ERRORS_MAGIC (0x4552525243000000ULL | CACHE_VERSION)
+#define VERSION_MAGIC (0x5645525243000000ULL | CACHE_VERSION)
+
+namespace {
+
+// FNV-1a, 64 bits
+class StructuralHash {
+public:
+  StructuralHash() : hash(14695981039346656037ULL) {
+  }
+
+  void add(const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  }
+
+  void add(uint64_t val) {
+    add(&val, sizeof(val));
+  }
+
+  void add(double val) {
+    add(&val, sizeof(val));
+  }
+
+  void add(StringRef str) {
+    add(static_cast<uint64_t>(str.size()));
+    add(str.data(), str.size());
+  }
+
+  uint64_t get() const {
+    return hash;
+  }
+
+private:
+  uint64_t hash;
+};
+
+enum OperandTag {
+  TagValue, TagBlock, TagFP, TagInt, TagGlobal, TagOther
+};
+
+class FunctionHasher {
+public:
+  FunctionHasher(const Function &F, const ValueNumbering &numbering) :
+    numbering(numbering) {
+    unsigned idx = 0;
+    for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB, ++idx) {
+      blocks[&*BB] = idx;
+    }
+  }
+
+  void addType(Type *type) {
+    DenseMap<Type *, std::string>::iterator found = types.find(type);
+    if (found == types.end()) {
+      std::string str;
+      raw_string_ostream os(str);
+      type->print(os);
+      found = types.insert(std::make_pair(type, os.str())).first;
+    }
+    H.add(StringRef(found->second));
+  }
+
+  void addOperand(const Value *val) {
+    unsigned idx = numbering.lookup(val);
+    if (idx != ValueNumbering::NotNumbered) {
+      H.add(static_cast<uint64_t>(TagValue));
+      H.add(static_cast<uint64_t>(idx));
+    } else if (const BasicBlock *BB = dyn_cast<BasicBlock>(val)) {
+      H.add(static_cast<uint64_t>(TagBlock));
+      H.add(static_cast<uint64_t>(blocks.lookup(BB)));
+    } else if (const ConstantFP *CFP = dyn_cast<ConstantFP>(val)) {
+      H.add(static_cast<uint64_t>(TagFP));
+      addType(CFP->getType());
+      APInt bits = CFP->getValueAPF().bitcastToAPInt();
+      H.add(bits.getRawData(), bits.getNumWords() * sizeof(uint64_t));
+    } else if (const ConstantInt *CI = dyn_cast<ConstantInt>(val)) {
+      H.add(static_cast<uint64_t>(TagInt));
+      addType(CI->getType());
+      const APInt &bits = CI->getValue();
+      H.add(bits.getRawData(), bits.getNumWords() * sizeof(uint64_t));
+    } else if (const GlobalValue *GV = dyn_cast<GlobalValue>(val)) {
+      H.add(static_cast<uint64_t>(TagGlobal));
+      H.add(GV->getName());
+      // The loads of the globals tracked by the range analysis depend on
+      // their initializer, hashed with their first use
+      const GlobalVariable *GVar = dyn_cast<GlobalVariable>(GV);
+      if (GVar != NULL && GVar->hasDefinitiveInitializer() && globals.insert(GVar).second) {
+        addOperand(GVar->getInitializer());
+      }
+    } else {
+      // Other constants, metadata, inline assembly...
+      std::string str;
+      raw_string_ostream os(str);
+      val->print(os);
+      H.add(static_cast<uint64_t>(TagOther));
+      H.add(StringRef(os.str()));
+    }
+  }
+
+  void addInstruction(const Instruction &I) {
+    H.add(static_cast<uint64_t>(I.getOpcode()));
+    H.add(static_cast<uint64_t>(I.getRawSubclassOptionalData()));
+    addType(I.getType());
+    if (const CmpInst *CI = dyn_cast<CmpInst>(&I)) {
+      H.add(static_cast<uint64_t>(CI->getPredicate()));
+    }
+    H.add(static_cast<uint64_t>(I.getNumOperands()));
+    for (User::const_op_iterator ops = I.op_begin(), opend = I.op_end(); ops != opend; ++ops) {
+      addOperand(ops->get());
+    }
+    if (const PHINode *PH = dyn_cast<PHINode>(&I)) {
+      for (unsigned i = 0; i < PH->getNumIncomingValues(); ++i) {
+        addOperand(PH->getIncomingBlock(i));
+      }
+    }
+  }
+
+  // Start the hash of another value, on its own
+  void restart() {
+    H = StructuralHash();
+    globals.clear();
+  }
+
+  StructuralHash H;
+
+private:
+  const ValueNumbering &numbering;
+  DenseMap<const BasicBlock *, unsigned> blocks;
+  DenseMap<Type *, std::string> types;
+  std::set<const GlobalVariable *> globals;
+};
+
+struct RangesHeader {
+  uint64_t magic;
+  uint64_t key;
+  uint32_t numValues;
+  uint32_t numEntries;
+  uint64_t minimumBits;
+  uint32_t minimumBitsValid;
+  uint32_t reserved;
+};
+
+enum RangeState {
+  StateTop, StateValid, StateBottom
+};
+
+struct RangeEntry {
+  uint32_t idx;
+  uint32_t state;
+  double min;
+  double max;
+};
+
+struct ErrorsHeader {
+  uint64_t magic;
+  uint64_t key;
+  uint32_t numValues;
+  uint32_t numEntries;
+  uint64_t decimalBitWidth;
+  double maxError;
+  uint32_t maxErrorValid;
+  uint32_t reserved;
+};
+
+struct VersionHeader {
+  uint64_t magic;
+  uint64_t name;
+  uint64_t key;
+  uint32_t numValues;
+  uint32_t numKnown;
+};
+
+enum ErrorFlags {
+  ErrorKnown = 1, ErrorValid = 2, PeakKnown = 4, PeakValid = 8
+};
+
+struct ErrorEntry {
+  uint32_t idx;
+  uint32_t flags;
+  double error;
+  double peak;
+};
+
+std::string getCachePath(uint64_t key, const char *extension) {
+  return CacheDir + "/" + utohexstr(key) + extension;
+}
+
+// A mapped cache file, valid if its header matches the expected one
+class MappedFile {
+public:
+  MappedFile(const std::string &path) : region(NULL) {
+    uint64_t size;
+    if (sys::fs::file_size(path, size) || size == 0)
+      return;
+    error_code ec;
+    region = new sys::fs::mapped_file_region(path, sys::fs::mapped_file_region::readonly,
+                                             size, 0, ec);
+    if (ec) {
+      delete region;
+      region = NULL;
+    }
+  }
+
+  ~MappedFile() {
+    delete region;
+  }
+
+  // Copy the object at the given offset, if the file is large enough
+  template <typename T>
+  bool read(uint64_t offset, T &obj) const {
+    if (region == NULL || offset + sizeof(T) > region->size())
+      return false;
+    memcpy(&obj, region->const_data() + offset, sizeof(T));
+    return true;
+  }
+
+private:
+  sys::fs::mapped_file_region *region;
+};
+
+void writeFile(const std::string &path, const std::vector<char> &data) {
+  SmallString<128> tmpPath;
+  int fd;
+  if (sys::fs::createUniqueFile(CacheDir + "/tmp-%%%%%%%%", fd, tmpPath)) {
+    DEBUG(errs() << "Cannot create a file in the cache directory " << CacheDir << "\n");
+    return;
+  }
+  bool failed;
+  {
+    raw_fd_ostream out(fd, true);
+    out.write(&data[0], data.size());
+    out.close();
+    failed = out.has_error();
+    out.clear_error();
+  }
+  // Readers see either the old file or the complete new one
+  if (failed || sys::fs::rename(tmpPath.str(), path)) {
+    bool existed;
+    sys::fs::remove(tmpPath.str(), existed);
+  }
+}
+
+template <typename T>
+void append(std::vector<char> &data, const T &obj) {
+  const char *bytes = reinterpret_cast<const char *>(&obj);
+  data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+RangeEntry makeEntry(unsigned idx, const Range &r) {
+  RangeEntry entry;
+  entry.idx = idx;
+  entry.state = r.isValid() ? StateValid : (r.isBottom() ? StateBottom : StateTop);
+  entry.min = r.getMin();
+  entry.max = r.getMax();
+  return entry;
+}
+
+Range getEntryRange(const RangeEntry &entry) {
+  if (entry.state == StateValid) {
+    return Range(entry.min, entry.max);
+  } else if (entry.state == StateBottom) {
+    return Range::Bottom();
+  }
+  return Range::Top;
+}
+
+uint64_t getVersionName(const Function &F, bool inContext) {
+  StructuralHash H;
+  H.add(static_cast<uint64_t>(CACHE_VERSION));
+  H.add(StringRef(getAnalysisConfiguration()));
+  H.add(StringRef(getFormatConfiguration()));
+  H.add(StringRef(F.getParent()->getModuleIdentifier()));
+  H.add(F.getName());
+  H.add(static_cast<uint64_t>(inContext));
+  return H.get();
+}
+
+}
+
+bool ResultCache::isEnabled() {
+  return !CacheDir.empty();
+}
+
+uint64_t ResultCache::computeKey(const Function &F, const ValueNumbering &numbering,
+                                 const input_ranges_t *inputRanges) {
+  FunctionHasher hasher(F, numbering);
+  hasher.H.add(static_cast<uint64_t>(CACHE_VERSION));
+  hasher.H.add(StringRef(getAnalysisConfiguration()));
+  hasher.H.add(StringRef(getFormatConfiguration()));
+  hasher.H.add(static_cast<uint64_t>(numbering.size()));
+  for (unsigned idx = 0; idx < numbering.size(); ++idx) {
+    const Value *val = numbering.getValue(idx);
+    if (const Instruction *I = dyn_cast<Instruction>(val)) {
+      hasher.addInstruction(*I);
+    } else {
+      hasher.addType(val->getType());
+    }
+    if (inputRanges != NULL) {
+      input_ranges_t::const_iterator found = inputRanges->find(val);
+      if (found != inputRanges->end()) {
+        Range r = found->second;
+        hasher.H.add(static_cast<uint64_t>(idx));
+        hasher.H.add(static_cast<uint64_t>(r.isValid()));
+        hasher.H.add(r.getMin());
+        hasher.H.add(r.getMax());
+      }
+    }
+  }
+  return hasher.H.get();
+}
+
+void ResultCache::computeSignatures(const Function &F, const ValueNumbering &numbering,
+                                    std::vector<uint64_t> &signatures) {
+  FunctionHasher hasher(F, numbering);
+  signatures.assign(numbering.size(), 0);
+  for (unsigned idx = numbering.getNumArguments(); idx < numbering.size(); ++idx) {
+    hasher.restart();
+    hasher.addInstruction(*cast<Instruction>(numbering.getValue(idx)));
+    signatures[idx] = hasher.H.get();
+  }
+}
+
+bool ResultCache::loadRanges(uint64_t key, unsigned numValues, range_store_t &store,
+                             OptionalValue<uint64_t> &minimumBits) {
+  MappedFile file(getCachePath(key, ".ranges"));
+  RangesHeader header;
+  if (!file.read(0, header) || header.magic != RANGES_MAGIC || header.key != key
+      || header.numValues != numValues) {
+    ++NumCacheMisses;
+    return false;
+  }
+
+  store.reset(numValues, Range::Top);
+  for (uint32_t i = 0; i < header.numEntries; ++i) {
+    RangeEntry entry;
+    if (!file.read(sizeof(header) + i * sizeof(entry), entry) || entry.idx >= numValues) {
+      ++NumCacheMisses;
+      return false;
+    }
+    store.set(entry.idx, getEntryRange(entry));
+  }
+  minimumBits = header.minimumBitsValid ? OptionalValue<uint64_t>(header.minimumBits)
+                : OptionalValue<uint64_t>::invalid();
+  ++NumCacheHits;
+  return true;
+}
+
+bool ResultCache::loadErrors(uint64_t key, unsigned numValues, FunctionErrors &errors) {
+  MappedFile file(getCachePath(key, ".errors"));
+  ErrorsHeader header;
+  if (!file.read(0, header) || header.magic != ERRORS_MAGIC || header.key != key
+      || header.numValues != numValues) {
+    ++NumCacheMisses;
+    return false;
+  }
+
+  errors.Errors.reset(numValues, OptionalValue<double>::invalid());
+  errors.Peaks.reset(numValues, OptionalValue<double>::invalid());
+  for (uint32_t i = 0; i < header.numEntries; ++i) {
+    ErrorEntry entry;
+    if (!file.read(sizeof(header) + i * sizeof(entry), entry) || entry.idx >= numValues) {
+      ++NumCacheMisses;
+      return false;
+    }
+    if (entry.flags & ErrorKnown) {
+      errors.Errors.set(entry.idx, (entry.flags & ErrorValid) ?
+                        OptionalValue<double>(entry.error) : OptionalValue<double>::invalid());
+    }
+    if (entry.flags & PeakKnown) {
+      errors.Peaks.set(entry.idx, (entry.flags & PeakValid) ?
+                       OptionalValue<double>(entry.peak) : OptionalValue<double>::invalid());
+    }
+  }
+  errors.DecimalBitWidth = header.decimalBitWidth;
+  errors.MaxError = header.maxErrorValid ? OptionalValue<double>(header.maxError)
+                    : OptionalValue<double>::invalid();
+  ++NumCacheHits;
+  return true;
+}
+
+void ResultCache::storeRanges(uint64_t key, const range_store_t &store,
+                              const OptionalValue<uint64_t> &minimumBits) {
+  std::vector<char> data;
+  RangesHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = RANGES_MAGIC;
+  header.key = key;
+  header.numValues = store.size();
+  header.minimumBitsValid = minimumBits.isValid();
+  header.minimumBits = minimumBits.isValid() ? minimumBits.get() : 0;
+  append(data, header);
+
+  for (unsigned idx = 0; idx < store.size(); ++idx) {
+    if (!store.has(idx))
+      continue;
+    append(data, makeEntry(idx, store.get(idx)));
+    ++header.numEntries;
+  }
+  memcpy(&data[0], &header, sizeof(header));
+
+  writeFile(getCachePath(key, ".ranges"), data);
+}
+
+void ResultCache::storeErrors(uint64_t key, const FunctionErrors &errors) {
+  std::vector<char> data;
+  ErrorsHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = ERRORS_MAGIC;
+  header.key = key;
+  header.numValues = errors.Errors.size();
+  header.decimalBitWidth = errors.DecimalBitWidth;
+  header.maxErrorValid = errors.MaxError.isValid();
+  header.maxError = errors.MaxError.isValid() ? errors.MaxError.get() : 0.0;
+  append(data, header);
+
+  for (unsigned idx = 0; idx < errors.Errors.size(); ++idx) {
+    ErrorEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.idx = idx;
+    if (errors.Errors.has(idx)) {
+      entry.flags |= ErrorKnown;
+      if (errors.Errors.get(idx).isValid()) {
+        entry.flags |= ErrorValid;
+        entry.error = errors.Errors.get(idx).get();
+      }
+    }
+    if (errors.Peaks.has(idx)) {
+      entry.flags |= PeakKnown;
+      if (errors.Peaks.get(idx).isValid()) {
+        entry.flags |= PeakValid;
+        entry.peak = errors.Peaks.get(idx).get();
+      }
+    }
+    if (entry.flags != 0) {
+      append(data, entry);
+      ++header.numEntries;
+    }
+  }
+  memcpy(&data[0], &header, sizeof(header));
+
+  writeFile(getCachePath(key, ".errors"), data);
+}
+
+bool ResultCache::loadVersion(const Function &F, bool inContext, FunctionVersion &version) {
+  uint64_t name = getVersionName(F, inContext);
+  MappedFile file(getCachePath(name, ".version"));
+  VersionHeader header;
+  if (!file.read(0, header) || header.magic != VERSION_MAGIC || header.name != name)
+    return false;
+
+  uint64_t offset = sizeof(header);
+  version.Key = header.key;
+  version.Signatures.resize(header.numValues);
+  for (uint32_t i = 0; i < header.numValues; ++i, offset += sizeof(uint64_t)) {
+    if (!file.read(offset, version.Signatures[i]))
+      return false;
+  }
+  version.KnownRanges.clear();
+  for (uint32_t i = 0; i < header.numKnown; ++i, offset += sizeof(RangeEntry)) {
+    RangeEntry entry;
+    if (!file.read(offset, entry) || entry.idx >= header.numValues)
+      return false;
+    version.KnownRanges.insert(std::make_pair(entry.idx, getEntryRange(entry)));
+  }
+  return true;
+}
+
+void ResultCache::storeVersion(const Function &F, bool inContext,
+                               const FunctionVersion &version) {
+  std::vector<char> data;
+  VersionHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = VERSION_MAGIC;
+  header.name = getVersionName(F, inContext);
+  header.key = version.Key;
+  header.numValues = version.Signatures.size();
+  header.numKnown = version.KnownRanges.size();
+  append(data, header);
+
+  for (std::vector<uint64_t>::const_iterator it = version.Signatures.begin(),
+       end = version.Signatures.end(); it != end; ++it) {
+    append(data, *it);
+  }
+  for (std::map<unsigned, Range>::const_iterator it = version.KnownRanges.begin(),
+       end = version.KnownRanges.end(); it != end; ++it) {
+    append(data, makeEntry(it->first, it->second));
+  }
+
+  writeFile(getCachePath(header.name, ".version"), data);
+}
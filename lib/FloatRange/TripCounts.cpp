@@ -0,0 +1,23 @@
+#include "TripCounts.h"
+
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+
+using namespace llvm;
+using namespace cto;
+
+void TripCounts::addLoop(Loop *loop, ScalarEvolution &SE) {
+  const SCEVConstant *CC = dyn_cast<SCEVConstant>(SE.getMaxBackedgeTakenCount(loop));
+  if (CC != NULL) {
+    counts[loop->getHeader()] = CC->getValue()->getValue().getZExtValue();
+  }
+  for (Loop::iterator sub = loop->begin(), end = loop->end(); sub != end; ++sub) {
+    addLoop(*sub, SE);
+  }
+}
+
+void TripCounts::compute(LoopInfo &LI, ScalarEvolution &SE) {
+  counts.clear();
+  for (LoopInfo::iterator loop = LI.begin(), end = LI.end(); loop != end; ++loop) {
+    addLoop(*loop, SE);
+  }
+}
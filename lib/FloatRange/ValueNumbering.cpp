@@ -0,0 +1,44 @@
+#include "ValueNumbering.h"
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/Support/CFG.h"
+
+using namespace llvm;
+using namespace cto;
+
+const unsigned ValueNumbering::NotNumbered;
+
+void ValueNumbering::add(Value *val) {
+  index[val] = values.size();
+  values.push_back(val);
+}
+
+void ValueNumbering::numberBlock(BasicBlock &BB) {
+  for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I) {
+    add(&*I);
+  }
+}
+
+void ValueNumbering::number(Function &F) {
+  index.clear();
+  values.clear();
+
+  for (Function::arg_iterator A = F.arg_begin(), AE = F.arg_end(); A != AE; ++A) {
+    add(&*A);
+  }
+  numArguments = values.size();
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (ReversePostOrderTraversal<Function *>::rpo_iterator BB = RPOT.begin(),
+       BE = RPOT.end(); BB != BE; ++BB) {
+    numberBlock(**BB);
+  }
+  // Unreachable blocks are not part of the traversal, but their instructions
+  // can still be reached through the use lists: number them last.
+  for (Function::iterator BB = F.begin(), BE = F.end(); BB != BE; ++BB) {
+    if (lookup(&BB->front()) == NotNumbered) {
+      numberBlock(*BB);
+    }
+  }
+}
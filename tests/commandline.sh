@@ -4,6 +4,10 @@
 # Simple invocation of llvm-float-range, for the purpose of
 # executing tests.
 # Please set the LLVM_BUILD environment variable to the directory where you built LLVM
+# Additional options for opt (e.g. -analysis-widening) can be passed through the
+# EXTRA_OPT_FLAGS environment variable, and module passes to be run before the
+# analyses (e.g. -float-range-ipa) through MODULE_OPT_FLAGS, and options for
+# clang (e.g. -D definitions) through CLANG_FLAGS.
 #
 
 if [ -z "$1" ]; then
@@ -29,13 +33,13 @@ if [ -d "$LLVM_BUILD/projects/float-range/Debug+Asserts" ]; then
     FLOATRANGEDIR="$LLVM_BUILD/projects/float-range/Debug+Asserts"
 fi
 
-"$OUTDIR/bin/clang" -emit-llvm "${1}" -c -o "${1}.bc"
+"$OUTDIR/bin/clang" $CLANG_FLAGS -emit-llvm "${1}" -c -o "${1}.bc"
 
-"$OUTDIR/bin/opt" -load "$FLOATRANGEDIR/lib/LLVMFloatRange.so" -stats -mem2reg -lcssa -float-range-analysis -precision-analysis -float2fix -dce -time-passes -debug  -precision-bitwidth "$PRECISION" -S < ${1}.bc > ${1}.ll 2> ${1}.log
+"$OUTDIR/bin/opt" -load "$FLOATRANGEDIR/lib/LLVMFloatRange.so" -stats -mem2reg -lcssa $MODULE_OPT_FLAGS -float-range-analysis -precision-analysis -float2fix -dce -time-passes -debug  -precision-bitwidth "$PRECISION" $EXTRA_OPT_FLAGS -S < ${1}.bc > ${1}.ll 2> ${1}.log
 
 rm "${1}.bc"
 
-"$OUTDIR/bin/clang" "${1}" -o "${1}.out.orig"
+"$OUTDIR/bin/clang" $CLANG_FLAGS "${1}" -o "${1}.out.orig"
 
 echo "Original program:"
 "./${1}.out.orig"
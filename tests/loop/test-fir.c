@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+#define TAPS 4
+
+static const double coeffs[TAPS] = { 0.25, 0.5, -0.125, 0.375 };
+
+/* The delay line is a local array, zeroed by its initializer, holding the
+   last inputs in [-8, 8], and the coefficients are read from a constant
+   array, in [-0.125, 0.5]: each product is within [-4, 4]. The delay line
+   is rewritten as an integer buffer */
+double f(double x __attribute__((float_range(-8, 8))), int n)
+{
+    double line[TAPS] = { 0 };
+    double y = 0.0;
+    for (int k = 0; k < n; ++k) {
+        for (int i = TAPS - 1; i > 0; --i) {
+            line[i] = line[i - 1];
+        }
+        line[0] = x;
+        y = 0.0;
+        for (int i = 0; i < TAPS; ++i) {
+            y += coeffs[i] * line[i];
+        }
+    }
+    return y;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(1, 1), f(-8, 3), f(8, 7));
+    printf("%f   %f   %f\n", f(0.5, 2), f(3, 4), f(-2.25, 10));
+}
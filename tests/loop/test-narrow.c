@@ -0,0 +1,27 @@
+#include <stdio.h>
+
+#define N 64
+
+/* Run with EXTRA_OPT_FLAGS=-fixed-point-narrowing: the samples in [-1, 1],
+   the gain in [0, 2] and the buffer fit 32 bit integers with the default
+   precision; only the products are widened to 64 bits before being
+   truncated, so that the second loop works on i32 rather than i64 */
+double f(double x __attribute__((float_range(-1, 1))),
+         double gain __attribute__((float_range(0, 2))))
+{
+    double buf[N];
+    double acc = 0.0;
+    for (int i = 0; i < N; ++i) {
+        buf[i] = x * gain * 0.5;
+    }
+    for (int i = 0; i < N; ++i) {
+        acc = buf[i] > acc ? buf[i] : acc;
+    }
+    return acc;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(-1, 0), f(0.5, 1), f(1, 2));
+    printf("%f   %f   %f\n", f(0.125, 1.5), f(-0.75, 0.25), f(0.999, 1.999));
+}
@@ -0,0 +1,27 @@
+#include <stdio.h>
+
+#define N 32
+
+/* The divisions in the loop are by the parameter scale, defined out of the
+   loop, and by the constant 3: both are lowered as products by reciprocals,
+   the first one computed once in the preheader of the loop */
+double f(double x __attribute__((float_range(-1, 1))),
+         double scale __attribute__((float_range(0.5, 4))))
+{
+    double buf[N];
+    double acc = 0.0;
+    for (int i = 0; i < N; ++i) {
+        buf[i] = x / scale;
+        x = x * 0.75;
+    }
+    for (int i = 0; i < N; ++i) {
+        acc = acc + buf[i] / 3.0;
+    }
+    return acc;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(1, 0.5), f(0.5, 1), f(-1, 4));
+    printf("%f   %f   %f\n", f(0.125, 1.5), f(-0.75, 0.625), f(0.999, 3.999));
+}
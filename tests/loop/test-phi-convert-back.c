@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+#define N 16
+
+double g(double x)
+{
+    return x * x;
+}
+
+/* The values loaded from buf reach a phi node, which is not converted since
+   the call to g is not: they are converted back to floating point at the
+   end of the incoming block, and the stores to buf are removed only if no
+   floating point load of buf is left */
+double f(double x __attribute__((float_range(-1, 1))), int c)
+{
+    double buf[N];
+    double acc = 0.0;
+    for (int i = 0; i < N; ++i) {
+        buf[i] = x * 0.5;
+        x = x * 0.75;
+    }
+    for (int i = 0; i < N; ++i) {
+        acc = acc + (c ? buf[i] : g(x));
+    }
+    return acc;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(1, 1), f(0.5, 0), f(-1, 1));
+    printf("%f   %f   %f\n", f(0.125, 0), f(-0.75, 1), f(0.999, 1));
+}
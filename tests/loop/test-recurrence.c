@@ -0,0 +1,17 @@
+#include <stdio.h>
+
+double f(double x __attribute__((float_range(-2, 2)))) {
+    double acc = 0.0;
+    double y = x;
+    for(int i = 0; i < 1000; ++i) {
+        acc += 0.25;
+        y = 0.5 * y + x;
+    }
+    return acc + y;
+}
+
+int main(int argc, char** argv) {
+    printf("%f\n", f(2));
+    printf("%f\n", f(0.3));
+    printf("%f\n", f(-1.7));
+}
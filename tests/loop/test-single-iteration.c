@@ -0,0 +1,17 @@
+#include <stdio.h>
+
+/* The loop is executed once, so its backedge is never taken: the value
+   stored in it is the only one read after the loop */
+double f(double x __attribute__((float_range(-2, 2))))
+{
+    double buf[1];
+    for (int i = 0; i < 1; ++i) {
+        buf[i] = x * 3.0;
+    }
+    return buf[0] + 1.0;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(2), f(0.5), f(-2));
+}
@@ -0,0 +1,16 @@
+#include <stdio.h>
+
+/* Run with EXTRA_OPT_FLAGS=-analysis-widening: the tripcount is not known */
+double f(double x __attribute__((float_range(-1, 1))), int n) {
+    double acc = 0.0;
+    for(int i = 0; i < n; ++i) {
+        acc = acc * 0.5 + x;
+    }
+    return acc;
+}
+
+int main(int argc, char** argv) {
+    printf("%f\n", f(1, 100));
+    printf("%f\n", f(0.3, 5));
+    printf("%f\n", f(-0.7, 1000));
+}
@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+/* Run with EXTRA_OPT_FLAGS=-float-range-domain=affine: b is y, and c is at
+   most 500000, while intervals lose the correlations with x and give
+   [-1010, 1010] and [0, 1000000] */
+double f(double x __attribute__((float_range(0, 1000))),
+         double y __attribute__((float_range(-10, 10))))
+{
+    double a = x + y;
+    double b = a - x;
+    double c = x * (1000.0 - x);
+    return b * c;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(0, 10), f(500, 10), f(1000, -10));
+    printf("%f   %f   %f\n", f(250, -10), f(500, -10), f(750, 3));
+}
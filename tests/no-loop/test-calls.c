@@ -0,0 +1,26 @@
+#include <stdio.h>
+
+/* No attributes: the ranges come from the call sites
+   (run with MODULE_OPT_FLAGS=-float-range-ipa) */
+static double scale(double x)
+{
+    return x * 2.5 + 1.0;
+}
+
+static double kernel(double a, double b)
+{
+    double s = scale(a) + scale(b);
+    return s / 4.0;
+}
+
+double f(double param __attribute__((float_range(-10, 10))))
+{
+    double k = kernel(param, param + 5.0);
+    return k * param;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(4), f(8), f(10));
+    printf("%f   %f   %f\n", f(-4), f(-8), f(-10));
+}
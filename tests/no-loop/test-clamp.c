@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <math.h>
+
+/* Clamps, casts and math functions stay in fixed point: x is clamped to
+   [0, 4] by the select, so that its square root is at most 2, and the
+   gain is a float extended to double */
+double f(double x __attribute__((float_range(-100, 100))),
+         float gain __attribute__((float_range(0, 2))),
+         int n)
+{
+    double c = x < 0.0 ? 0.0 : x;
+    c = c > 4.0 ? 4.0 : c;
+    double r = sqrt(c) * gain;
+    double m = fmax(fmin(r, 3.0), fabs(x - 50.0) / 64.0);
+    return m + (n & 7);
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(-100, 0, 0), f(2, 1.5f, 3), f(100, 2, 7));
+    printf("%f   %f   %f\n", f(3.5, 0.25f, 1), f(-7, 2, 5), f(50, 1, 2));
+}
@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+/* Run with EXTRA_OPT_FLAGS=-float-range-domain=interval-set: d is in
+   [-5, -4] U [4, 5], so the quotient is bounded, while the divisor [-5, 5]
+   of the single range contains zero */
+double f(double x __attribute__((float_range(4, 5))), int negate)
+{
+    double d;
+    if (negate) {
+        d = -x;
+    } else {
+        d = x;
+    }
+    return 10.0 / d + x;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(4, 0), f(4.5, 0), f(5, 0));
+    printf("%f   %f   %f\n", f(4, 1), f(4.5, 1), f(5, 1));
+}
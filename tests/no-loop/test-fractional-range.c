@@ -0,0 +1,16 @@
+#include <stdio.h>
+
+/* The bounds of x are fractional: its range is [-0.001, 0.001] rather than
+   [-1, 1], so that y * y is at most 4e-06 and needs fewer integer bits */
+double f(double x __attribute__((float_range(-1e-3, 0.001))),
+         double k __attribute__((float_range(0.5, 2))))
+{
+    double y = x * k;
+    return y * y + 0.25;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(-0.001, 0.5), f(0, 1), f(0.001, 2));
+    printf("%f   %f   %f\n", f(0.0005, 1.5), f(-0.0002, 0.75), f(0.0009, 2));
+}
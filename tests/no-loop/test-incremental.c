@@ -0,0 +1,28 @@
+#include <stdio.h>
+
+#ifndef GAIN
+#define GAIN 0.5
+#endif
+
+/* To be run twice with the same cache, e.g.
+     EXTRA_OPT_FLAGS=-float-range-cache=/tmp/frc ./commandline.sh test-incremental.c
+     EXTRA_OPT_FLAGS=-float-range-cache=/tmp/frc CLANG_FLAGS=-DGAIN=0.25 \
+       ./commandline.sh test-incremental.c
+   The second run only changes the product by GAIN: -stats reports the
+   instructions analyzed again by the range updates, i.e. the product and
+   its users, while the values computed from a and b keep their ranges */
+double f(double a __attribute__((float_range(-1, 1))),
+         double b __attribute__((float_range(0, 2))))
+{
+    double s = a + b;
+    double d = a - b;
+    double p = s * d;
+    double q = p / 4.0;
+    double g = d * GAIN;
+    return q + g;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(1, 0), f(0.5, 1.5), f(-1, 2));
+}
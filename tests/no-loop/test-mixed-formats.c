@@ -0,0 +1,17 @@
+#include <stdio.h>
+
+/* big needs 22 integer bits and small only 2: each gets the fixed point
+   format of its own range, so small keeps 31 fractional bits instead of the
+   21 of big, and is only aligned to big for the sum */
+double f(double big __attribute__((float_range(-1e6, 1e6))),
+         double small __attribute__((float_range(-1, 1))))
+{
+    double s = small * small * 0.001;
+    return big + s / 3.0;
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(-1e6, -1), f(0, 0.5), f(1e6, 1));
+    printf("%f   %f   %f\n", f(12345.678, 0.125), f(-0.001, -0.3), f(999.5, 0.7));
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+/* The range of a - b is [min(a) - max(b), max(a) - min(b)]: with the
+ * extremes of the inputs, the conversion must not overflow */
+double fun(double p1 __attribute__((float_range(0, 10))),
+        double p2 __attribute__((float_range(0, 100)))) {
+    double d = p1 - p2;
+    return d * 2.5;
+}
+
+int main() {
+    printf("%f %f %f\n", fun(0, 100), fun(10, 0), fun(5, 5));
+}
@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+typedef double v2df __attribute__((vector_size(16)));
+
+/* The lanes of v are x and y, inserted in a vector whose range is the one
+   of both: the vector arithmetic, the shuffle swapping the lanes and the
+   extraction of the result are converted to <2 x i64> */
+double f(double x __attribute__((float_range(-2, 2))),
+         double y __attribute__((float_range(0, 1))))
+{
+    v2df v = { x, y };
+    v2df k = { 0.5, 0.25 };
+    v2df s = v * k + __builtin_shufflevector(v, v, 1, 0);
+    return s[0] - s[1];
+}
+
+int main(int argc, char** argv)
+{
+    printf("%f   %f   %f\n", f(-2, 0), f(0.5, 0.5), f(2, 1));
+    printf("%f   %f   %f\n", f(1.25, 0.125), f(-0.75, 0.9), f(0, 0));
+}